@@ -0,0 +1,188 @@
+#ifndef MPI_ADAPTIVE_H
+#define MPI_ADAPTIVE_H
+
+#include <chrono>
+
+#include "common.h"
+#include "bits.h"
+#include "wide.h"
+
+// One pass adaptive Huffman coding for byte streams
+// Encoder and decoder start from the same flat table and rebuild a canonical table from
+// counts seen so far after every `period` elements, so the code of each element is
+// emitted as soon as it arrives and no dict is transferred.
+// A rebuild only depends on the alphabet size (256), never on stream length,
+// so the cost of one rebuild is bounded and amortized over `period` elements.
+
+namespace Huffman {
+
+    // Canonical code table of byte alphabet with bit serial decoding state
+    class AdaptiveTable {
+    public:
+        static const size_t Alphabet = 256;
+        // Counts are halved when their sum exceeds this, older data weighs less
+        static const uint64_t RescaleLimit = 1 << 20;
+
+    private:
+        std::vector<uint64_t> counts;
+        std::vector<uint8_t> lengths;
+        std::vector<uint32_t> codes;
+
+        // Canonical decoding: first code, first position in sorted order and code count of every length
+        std::vector<uint32_t> first_code;
+        std::vector<uint32_t> first_index;
+        std::vector<uint32_t> count;
+        std::vector<uint8_t> sorted;
+
+        size_t period;
+        size_t seen = 0;
+        size_t rebuilt = 0;
+        double slowest = 0.;
+
+        void rebuild() {
+            auto start = std::chrono::steady_clock::now();
+            uint64_t total = 0;
+            for (const auto &value: this->counts)
+                total += value;
+            if (total > RescaleLimit)
+                for (auto &value: this->counts)
+                    value = (value + 1) / 2;
+
+            this->lengths = code_lengths(this->counts);
+            this->codes = canonical_codes(this->lengths);
+
+            // Same order as canonical_codes: by length, then by symbol
+            this->sorted.clear();
+            for (size_t symbol = 0; symbol < Alphabet; ++symbol)
+                this->sorted.push_back(static_cast<uint8_t>(symbol));
+            std::stable_sort(this->sorted.begin(), this->sorted.end(), [&](uint8_t a, uint8_t b) {
+                return this->lengths[a] < this->lengths[b];
+            });
+            this->first_code.assign(MaxCodeLength + 1, 0);
+            this->first_index.assign(MaxCodeLength + 1, 0);
+            this->count.assign(MaxCodeLength + 1, 0);
+            for (size_t index = Alphabet; index-- > 0;) {
+                auto symbol = this->sorted[index];
+                auto length = this->lengths[symbol];
+                this->first_code[length] = this->codes[symbol];
+                this->first_index[length] = static_cast<uint32_t>(index);
+                this->count[length]++;
+            }
+
+            this->rebuilt++;
+            this->slowest = std::max(this->slowest, std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count());
+        }
+
+    public:
+        explicit AdaptiveTable(size_t period) : counts(Alphabet, 1), period(std::max<size_t>(period, 1)) {
+            this->rebuild();
+        }
+
+        // Count element, rebuild table after every period elements
+        void update(uint8_t symbol) {
+            this->counts[symbol]++;
+            if (++this->seen % this->period == 0)
+                this->rebuild();
+        }
+
+        [[nodiscard]] uint32_t code(uint8_t symbol) const {
+            return this->codes[symbol];
+        }
+
+        [[nodiscard]] uint8_t length(uint8_t symbol) const {
+            return this->lengths[symbol];
+        }
+
+        // Check if code of given length is complete, set symbol if so
+        bool match(uint32_t code, unsigned length, uint8_t &symbol) const {
+            if (length > MaxCodeLength)
+                throw std::invalid_argument("invalid code");
+            uint32_t offset = code - this->first_code[length];
+            if (!this->count[length] || code < this->first_code[length] || offset >= this->count[length])
+                return false;
+            symbol = this->sorted[this->first_index[length] + offset];
+            return true;
+        }
+
+        // Number of rebuilds and slowest rebuild in seconds
+        [[nodiscard]] size_t rebuilds() const {
+            return this->rebuilt;
+        }
+
+        [[nodiscard]] double slowest_rebuild() const {
+            return this->slowest;
+        }
+    };
+
+    template<typename T>
+    class AdaptiveEncoder {
+        static_assert(sizeof(T) == 1, "adaptive coding works on byte alphabets");
+
+    private:
+        AdaptiveTable table;
+
+    public:
+        explicit AdaptiveEncoder(size_t period = 4096) : table(period) {}
+
+        // Append code of element to output immediately
+        void push(const T &element, std::vector<bool> &output) {
+            auto symbol = static_cast<uint8_t>(element);
+            Bits::append(output, this->table.code(symbol), this->table.length(symbol));
+            this->table.update(symbol);
+        }
+
+        template<class Iterator>
+        std::vector<bool> encode(Iterator begin, Iterator end) {
+            std::vector<bool> encoded;
+            while (begin != end)
+                this->push(*begin++, encoded);
+            return encoded;
+        }
+
+        [[nodiscard]] const AdaptiveTable &state() const {
+            return this->table;
+        }
+    };
+
+    template<typename T>
+    class AdaptiveDecoder {
+        static_assert(sizeof(T) == 1, "adaptive coding works on byte alphabets");
+
+    private:
+        AdaptiveTable table;
+        // Partial code carried over between feeds
+        uint32_t code = 0;
+        unsigned length = 0;
+
+    public:
+        explicit AdaptiveDecoder(size_t period = 4096) : table(period) {}
+
+        // Feed newly arrived bits, every completed element is written to inserter at once
+        template<class Inserter>
+        void feed(const std::vector<bool> &bits, Inserter inserter) {
+            uint8_t symbol;
+            for (const auto &bit: bits) {
+                this->code = (this->code << 1) | bit;
+                this->length++;
+                if (this->table.match(this->code, this->length, symbol)) {
+                    inserter = static_cast<T>(symbol);
+                    this->table.update(symbol);
+                    this->code = 0;
+                    this->length = 0;
+                }
+            }
+        }
+
+        // True if fed bits end on element boundary
+        [[nodiscard]] bool aligned() const {
+            return this->length == 0;
+        }
+
+        [[nodiscard]] const AdaptiveTable &state() const {
+            return this->table;
+        }
+    };
+}
+
+#endif //MPI_ADAPTIVE_H
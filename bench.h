@@ -0,0 +1,188 @@
+#ifndef MPI_BENCH_H
+#define MPI_BENCH_H
+
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <functional>
+
+#include "common.h"
+#include "stats.h"
+
+// Minimal benchmark harness, modeled after Google Benchmark:
+// each case is repeated several times and the fastest run is reported,
+// MPI cases take the slowest rank of every run as its time.
+
+namespace Bench {
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Result {
+        std::string name;
+        std::string profile;
+        size_t size = 0;
+        size_t iterations = 0;
+        double best = 0.;       // seconds of fastest iteration
+        double mean = 0.;       // seconds of mean iteration
+        double ratio = 0.;      // output size / input size, 0 if not applicable
+        int ranks = 1;
+
+        [[nodiscard]] double throughput() const {
+            return this->best > 0. ? static_cast<double>(this->size) / 1e6 / this->best : 0.;
+        }
+    };
+
+    // Prevent compiler from discarding benchmarked result
+    template<typename T>
+    inline void keep(const T &value) {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // Run function repeatedly, the function returns output size in bits (0 if meaningless)
+    // When mpi is set, every rank must call this function and all ranks are synchronized
+    // before each iteration
+    inline Result run(const std::string &name, const std::string &profile, size_t size, size_t iterations,
+                      const std::function<size_t()> &function, bool mpi = false) {
+        Result result;
+        result.name = name;
+        result.profile = profile;
+        result.size = size;
+        result.iterations = iterations;
+        if (mpi)
+            MPI_Comm_size(MPI_COMM_WORLD, &result.ranks);
+
+        double total = 0.;
+        size_t output = 0;
+        for (size_t iteration = 0; iteration < iterations; ++iteration) {
+            if (mpi)
+                MPI_Barrier(MPI_COMM_WORLD);
+            auto start = Clock::now();
+            output = function();
+            double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+            if (mpi)
+                MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+            total += elapsed;
+            if (iteration == 0 || elapsed < result.best)
+                result.best = elapsed;
+        }
+        result.mean = iterations ? total / static_cast<double>(iterations) : 0.;
+        if (output && size)
+            result.ratio = static_cast<double>(output) / static_cast<double>(size * 8);
+        return result;
+    }
+
+    // Machine readable output: one JSON object per line, or CSV with header
+    inline std::string json(const Result &result) {
+        std::ostringstream stream;
+        stream << "{\"name\":\"" << result.name << "\",\"profile\":\"" << result.profile
+               << "\",\"size\":" << result.size << ",\"ranks\":" << result.ranks
+               << ",\"iterations\":" << result.iterations << ",\"best_seconds\":" << result.best
+               << ",\"mean_seconds\":" << result.mean << ",\"mb_per_second\":" << result.throughput()
+               << ",\"ratio\":" << result.ratio << ",\"stats\":" << (Stats::enabled() ? "true" : "false") << "}";
+        return stream.str();
+    }
+
+    inline std::string csv_header() {
+        return "name,profile,size,ranks,iterations,best_seconds,mean_seconds,mb_per_second,ratio,stats";
+    }
+
+    inline std::string csv(const Result &result) {
+        std::ostringstream stream;
+        stream << result.name << "," << result.profile << "," << result.size << "," << result.ranks << ","
+               << result.iterations << "," << result.best << "," << result.mean << ","
+               << result.throughput() << "," << result.ratio << "," << Stats::enabled();
+        return stream.str();
+    }
+
+    // Input generators for different entropy profiles,
+    // seeded deterministically so that every rank generates the same input
+    namespace Profile {
+        // Every byte value with same probability, nearly incompressible
+        inline std::string uniform(size_t n, uint32_t seed = 1) {
+            std::mt19937 generator(seed);
+            std::uniform_int_distribution<int> distribution(0, 255);
+            std::string result(n, 0);
+            for (auto &item: result)
+                item = static_cast<char>(distribution(generator));
+            return result;
+        }
+
+        // Byte value k with probability proportional to 1 / (k + 1)
+        inline std::string zipf(size_t n, uint32_t seed = 1) {
+            std::vector<double> weights;
+            for (int rank = 0; rank < 256; ++rank)
+                weights.push_back(1. / (rank + 1));
+            std::mt19937 generator(seed);
+            std::discrete_distribution<int> distribution(weights.begin(), weights.end());
+            std::string result(n, 0);
+            for (auto &item: result)
+                item = static_cast<char>(distribution(generator));
+            return result;
+        }
+
+        // Long runs of few symbols, run length is geometric with mean about 64
+        inline std::string runs(size_t n, uint32_t seed = 1) {
+            std::mt19937 generator(seed);
+            std::geometric_distribution<size_t> length(1. / 64);
+            std::uniform_int_distribution<int> symbol('A', 'H');
+            std::string result;
+            while (result.size() < n)
+                result.append(std::min(length(generator) + 1, n - result.size()),
+                              static_cast<char>(symbol(generator)));
+            return result;
+        }
+
+        // Repeat given text sample until size reached, or pseudo English words without sample
+        inline std::string text(size_t n, const std::string &sample = "", uint32_t seed = 1) {
+            std::string result;
+            if (!sample.empty()) {
+                while (result.size() < n)
+                    result.append(sample, 0, std::min(sample.size(), n - result.size()));
+                return result;
+            }
+            static const std::vector<std::string> words = {
+                    "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with",
+                    "be", "by", "on", "not", "he", "this", "are", "or", "his", "from", "at", "which",
+                    "but", "have", "an", "had", "they", "you", "were", "their", "one", "all", "we",
+                    "huffman", "encoding", "message", "process", "manager", "worker", "tree", "node"};
+            std::vector<double> weights;
+            for (size_t rank = 0; rank < words.size(); ++rank)
+                weights.push_back(1. / static_cast<double>(rank + 1));
+            std::mt19937 generator(seed);
+            std::discrete_distribution<size_t> distribution(weights.begin(), weights.end());
+            size_t sentence = 0;
+            while (result.size() < n) {
+                const auto &word = words[distribution(generator)];
+                result.append(word);
+                result.push_back(++sentence % 12 == 0 ? '\n' : ' ');
+            }
+            result.resize(n);
+            return result;
+        }
+
+        inline std::string generate(const std::string &profile, size_t n, const std::string &sample = "") {
+            if (profile == "uniform")
+                return uniform(n);
+            if (profile == "zipf")
+                return zipf(n);
+            if (profile == "runs")
+                return runs(n);
+            if (profile == "text")
+                return text(n, sample);
+            throw std::invalid_argument("unknown profile: " + profile);
+        }
+    }
+
+    // Split comma separated option value
+    inline std::vector<std::string> split(const std::string &value) {
+        std::vector<std::string> result;
+        std::stringstream stream(value);
+        std::string item;
+        while (std::getline(stream, item, ','))
+            if (!item.empty())
+                result.push_back(item);
+        return result;
+    }
+}
+
+#endif //MPI_BENCH_H
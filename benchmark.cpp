@@ -0,0 +1,387 @@
+#include <iostream>
+
+#include "common.h"
+
+#include "huffman.h"
+#include "rle.h"
+#include "wide.h"
+#include "lz77.h"
+#include "adaptive.h"
+#include "block.h"
+#include "bench.h"
+
+// Benchmark every engine across input sizes and entropy profiles
+//   Usage: mpirun -n <ranks> benchmark [--sizes 10000,100000] [--profiles uniform,zipf,runs,text]
+//                                      [--repeat 5] [--format json|csv] [--text <sample file>]
+// Serial engines run on manager process only, MPI engines run on all processes.
+
+// Recursive binary heap used before iterative heap, kept as baseline of heap benchmarks
+namespace Legacy {
+    template<typename T>
+    class MinHeap {
+    private:
+        std::vector<T> pool;
+
+    public:
+        T &at(size_t index) {
+            if (index < this->pool.size())
+                return this->pool.at(index);
+            throw std::out_of_range("invalid index");
+        }
+
+        [[nodiscard]] size_t size() const {
+            return this->pool.size();
+        }
+
+    private:
+        void float_(size_t index) {
+            if (index == 0)
+                return;
+            size_t father = (index - 1) / 2;
+            if (this->at(index) < this->at(father)) {
+                std::swap(this->at(index), this->at(father));
+                this->float_(father);
+            }
+        }
+
+        void sink(size_t index) {
+            size_t left = index * 2 + 1;
+            size_t right = left + 1;
+            if (right >= this->pool.size())
+                right = left;
+            if (left >= this->pool.size())
+                return;
+            size_t minimal = this->at(left) <= this->at(right) ? left : right;
+            if (this->at(minimal) < this->at(index)) {
+                std::swap(this->at(minimal), this->at(index));
+                this->sink(minimal);
+            }
+        }
+
+    public:
+        void append(const T &element) {
+            this->pool.push_back(element);
+            this->float_(this->pool.size() - 1);
+        }
+
+        T pop() {
+            if (this->pool.size() == 0)
+                throw std::out_of_range("invalid index");
+            std::swap(this->at(0), this->at(this->pool.size() - 1));
+            const T element = this->pool.back();
+            this->pool.pop_back();
+            this->sink(0);
+            return element;
+        }
+    };
+}
+
+struct Options {
+    std::vector<size_t> sizes = {10000, 100000};
+    std::vector<std::string> profiles = {"uniform", "zipf", "runs", "text"};
+    size_t repeat = 5;
+    std::string format = "json";
+    std::string sample;
+};
+
+static Options parse(int argc, char **argv) {
+    Options options;
+    for (int index = 1; index + 1 < argc; index += 2) {
+        std::string key = argv[index];
+        std::string value = argv[index + 1];
+        if (key == "--sizes") {
+            options.sizes.clear();
+            for (const auto &item: Bench::split(value))
+                options.sizes.push_back(std::stoul(item));
+        } else if (key == "--profiles") {
+            options.profiles = Bench::split(value);
+        } else if (key == "--repeat") {
+            options.repeat = std::stoul(value);
+        } else if (key == "--format") {
+            options.format = value;
+        } else if (key == "--text") {
+            std::ifstream reader(value, std::ios::in | std::ios::binary);
+            options.sample.assign(std::istreambuf_iterator<char>(reader), std::istreambuf_iterator<char>());
+        } else {
+            throw std::invalid_argument("unknown option: " + key);
+        }
+    }
+    return options;
+}
+
+static void report(const Options &options, const Bench::Result &result) {
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    if (world_rank != 0)
+        return;
+    if (options.format == "csv")
+        std::cout << Bench::csv(result) << std::endl;
+    else
+        std::cout << Bench::json(result) << std::endl;
+}
+
+// Heap micro benchmarks: fill with one node per input element and drain,
+// keys are input bytes mixed with position so that there are few ties
+static void heaps(const Options &options, const std::string &profile, const std::string &source) {
+    using NodeT = Huffman::Node<uint32_t>;
+    size_t n = source.size();
+    std::vector<uint64_t> keys;
+    keys.reserve(n);
+    for (size_t index = 0; index < n; ++index)
+        keys.push_back(static_cast<uint64_t>(static_cast<uint8_t>(source[index])) << 16 |
+                       ((index * 2654435761u) >> 16 & 0xffff));
+
+    report(options, Bench::run("heap_legacy", profile, n, options.repeat, [&]() {
+        Legacy::MinHeap<NodeT> heap;
+        for (size_t index = 0; index < n; ++index)
+            heap.append(NodeT(static_cast<uint32_t>(index), keys[index]));
+        while (heap.size())
+            Bench::keep(heap.pop().data);
+        return static_cast<size_t>(0);
+    }));
+
+    report(options, Bench::run("heap_binary", profile, n, options.repeat, [&]() {
+        Heap::MinHeap<NodeT> heap;
+        heap.reserve(n);
+        for (size_t index = 0; index < n; ++index)
+            heap.append(NodeT(static_cast<uint32_t>(index), keys[index]));
+        while (heap.size())
+            Bench::keep(heap.pop().data);
+        return static_cast<size_t>(0);
+    }));
+
+    report(options, Bench::run("heap_4ary", profile, n, options.repeat, [&]() {
+        Heap::MinHeap<NodeT, 4> heap;
+        heap.reserve(n);
+        for (size_t index = 0; index < n; ++index)
+            heap.append(NodeT(static_cast<uint32_t>(index), keys[index]));
+        while (heap.size())
+            Bench::keep(heap.pop().data);
+        return static_cast<size_t>(0);
+    }));
+
+    report(options, Bench::run("heap_heapify", profile, n, options.repeat, [&]() {
+        std::vector<NodeT> nodes;
+        nodes.reserve(n);
+        for (size_t index = 0; index < n; ++index)
+            nodes.emplace_back(static_cast<uint32_t>(index), keys[index]);
+        Heap::MinHeap<NodeT, 4> heap(std::move(nodes));
+        while (heap.size())
+            Bench::keep(heap.pop().data);
+        return static_cast<size_t>(0);
+    }));
+
+    report(options, Bench::run("heap_index", profile, n, options.repeat, [&]() {
+        std::vector<Heap::Entry<uint64_t>> entries;
+        entries.reserve(n);
+        for (size_t index = 0; index < n; ++index)
+            entries.push_back({keys[index], static_cast<uint32_t>(index)});
+        Heap::IndexHeap<uint64_t> heap(std::move(entries));
+        while (heap.size())
+            Bench::keep(heap.pop().index);
+        return static_cast<size_t>(0);
+    }));
+}
+
+static void serial(const Options &options, const std::string &profile, const std::string &source) {
+    size_t n = source.size();
+
+    report(options, Bench::run("statistic", profile, n, options.repeat, [&]() {
+        Bench::keep(Huffman::statistic(source.begin(), source.end()).size());
+        return static_cast<size_t>(0);
+    }));
+
+    std::map<char, uint64_t> counts;
+    for (const auto &pair: Huffman::statistic(source.begin(), source.end()))
+        counts[pair.first] = pair.second;
+    report(options, Bench::run("tree", profile, n, options.repeat, [&]() {
+        Huffman::Tree<char> tree(counts);
+        Bench::keep(tree.root);
+        return static_cast<size_t>(0);
+    }));
+
+    Huffman::Encoder<char> encoder(source.begin(), source.end());
+    auto dict = encoder.dict();
+    std::vector<bool> content;
+    report(options, Bench::run("encode", profile, n, options.repeat, [&]() {
+        content = encoder.encode();
+        return dict.size() + content.size();
+    }));
+
+    std::vector<bool> encoded(dict.begin(), dict.end());
+    encoded.insert(encoded.end(), content.begin(), content.end());
+    report(options, Bench::run("decode", profile, n, options.repeat, [&]() {
+        Huffman::Decoder<char> decoder(encoded);
+        std::string decoded;
+        decoder.decode(std::back_inserter(decoded));
+        if (decoded != source)
+            throw std::runtime_error("decode mismatch");
+        return static_cast<size_t>(0);
+    }));
+
+    // Same input as 16 bits tokens through dense remapping and table decoding
+    std::vector<uint16_t> tokens(source.begin(), source.end());
+    Huffman::WideEncoder<uint16_t> wide(tokens.begin(), tokens.end());
+    std::vector<bool> wide_encoded;
+    report(options, Bench::run("wide_encode", profile, n, options.repeat, [&]() {
+        wide_encoded = wide.dict();
+        auto body = wide.encode();
+        wide_encoded.insert(wide_encoded.end(), body.begin(), body.end());
+        return wide_encoded.size();
+    }));
+
+    report(options, Bench::run("wide_decode", profile, n, options.repeat, [&]() {
+        Huffman::WideDecoder<uint16_t> decoder(wide_encoded);
+        std::vector<uint16_t> decoded;
+        decoder.decode(std::back_inserter(decoded));
+        if (decoded != tokens)
+            throw std::runtime_error("wide decode mismatch");
+        return static_cast<size_t>(0);
+    }));
+
+    for (int level: {1, 6, 9}) {
+        std::vector<bool> lz77_encoded;
+        auto name = "lz77_" + std::to_string(level);
+        report(options, Bench::run(name + "_compress", profile, n, options.repeat, [&]() {
+            lz77_encoded = LZ77::compress(source.begin(), source.end(), LZ77::preset(level));
+            return lz77_encoded.size();
+        }));
+
+        report(options, Bench::run(name + "_decompress", profile, n, options.repeat, [&]() {
+            std::string decoded;
+            LZ77::decompress(lz77_encoded, std::back_inserter(decoded));
+            if (decoded != source)
+                throw std::runtime_error("lz77 decompress mismatch");
+            return static_cast<size_t>(0);
+        }));
+    }
+
+    // One pass adaptive coding, decoder is fed in small chunks as a live stream would arrive
+    for (size_t period: {1024, 16384}) {
+        std::vector<bool> adaptive_encoded;
+        auto name = "adaptive_" + std::to_string(period);
+        report(options, Bench::run(name + "_encode", profile, n, options.repeat, [&]() {
+            Huffman::AdaptiveEncoder<char> adaptive(period);
+            adaptive_encoded = adaptive.encode(source.begin(), source.end());
+            return adaptive_encoded.size();
+        }));
+
+        report(options, Bench::run(name + "_decode", profile, n, options.repeat, [&]() {
+            Huffman::AdaptiveDecoder<char> adaptive(period);
+            std::string decoded;
+            for (size_t index = 0; index < adaptive_encoded.size(); index += 4096) {
+                auto stop = std::min(index + 4096, adaptive_encoded.size());
+                std::vector<bool> chunk(adaptive_encoded.begin() + static_cast<long>(index),
+                                        adaptive_encoded.begin() + static_cast<long>(stop));
+                adaptive.feed(chunk, std::back_inserter(decoded));
+            }
+            if (decoded != source || !adaptive.aligned())
+                throw std::runtime_error("adaptive decode mismatch");
+            Bench::keep(adaptive.state().slowest_rebuild());
+            return static_cast<size_t>(0);
+        }));
+    }
+
+    std::string rle_encoded;
+    report(options, Bench::run("rle_encode", profile, n, options.repeat, [&]() {
+        rle_encoded.clear();
+        RLE::encode(source.begin(), source.end(), std::back_inserter(rle_encoded));
+        return rle_encoded.size() * 8;
+    }));
+
+    report(options, Bench::run("rle_decode", profile, n, options.repeat, [&]() {
+        std::string decoded;
+        RLE::decode(rle_encoded.begin(), rle_encoded.end(), std::back_inserter(decoded));
+        if (decoded != source)
+            throw std::runtime_error("rle decode mismatch");
+        return static_cast<size_t>(0);
+    }));
+
+    // Self contained block with mode picked from entropy estimate
+    std::vector<char> block;
+    report(options, Bench::run("block_compress", profile, n, options.repeat, [&]() {
+        Block::compress(source.begin(), source.end(), block);
+        return block.size() * 8;
+    }));
+
+    report(options, Bench::run("block_decompress", profile, n, options.repeat, [&]() {
+        std::string decoded;
+        Block::decompress(block, std::back_inserter(decoded));
+        if (decoded != source)
+            throw std::runtime_error("block decompress mismatch");
+        return static_cast<size_t>(0);
+    }));
+}
+
+static void parallel(const Options &options, const std::string &profile, const std::string &source) {
+    size_t n = source.size();
+
+    report(options, Bench::run("mpi_statistic", profile, n, options.repeat, [&]() {
+        Bench::keep(Huffman::MPI_Statistic(source.begin(), source.end()).size());
+        return static_cast<size_t>(0);
+    }, true));
+
+    Huffman::Encoder<char> encoder(source.begin(), source.end(), true);
+    auto dict = encoder.dict();
+    report(options, Bench::run("mpi_encode", profile, n, options.repeat, [&]() {
+        return dict.size() + encoder.MPI_Encode(source.begin(), source.end()).size();
+    }, true));
+
+    report(options, Bench::run("mpi_encode_pipelined", profile, n, options.repeat, [&]() {
+        return dict.size() + encoder.MPI_Encode_pipelined(source.begin(), source.end()).size();
+    }, true));
+
+    report(options, Bench::run("mpi_lz77_compress", profile, n, options.repeat, [&]() {
+        return LZ77::MPI_Compress(source.begin(), source.end()).size();
+    }, true));
+
+    std::string rle_encoded;
+    report(options, Bench::run("mpi_rle_encode", profile, n, options.repeat, [&]() {
+        rle_encoded.clear();
+        RLE::MPI_Encode(source.begin(), source.end(), std::back_inserter(rle_encoded));
+        return rle_encoded.size() * 8;
+    }, true));
+
+    report(options, Bench::run("mpi_rle_encode_pipelined", profile, n, options.repeat, [&]() {
+        std::string encoded;
+        RLE::MPI_Encode_pipelined(source.begin(), source.end(), std::back_inserter(encoded));
+        return encoded.size() * 8;
+    }, true));
+
+    report(options, Bench::run("mpi_rle_decode", profile, n, options.repeat, [&]() {
+        std::string decoded;
+        RLE::MPI_Decode(rle_encoded.begin(), rle_encoded.end(), std::back_inserter(decoded));
+        if (decoded != source)
+            throw std::runtime_error("mpi rle decode mismatch");
+        return static_cast<size_t>(0);
+    }, true));
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+    Options options = parse(argc, argv);
+    if (world_rank == 0 && options.format == "csv")
+        std::cout << Bench::csv_header() << std::endl;
+
+    for (const auto &profile: options.profiles) {
+        for (const auto &size: options.sizes) {
+            std::string source = Bench::Profile::generate(profile, size, options.sample);
+            if (world_rank == 0) {
+                heaps(options, profile, source);
+                serial(options, profile, source);
+            }
+            parallel(options, profile, source);
+        }
+    }
+
+    // Counters of whole run, build with -DHUFFMAN_STATS (make benchmark_stats) to enable
+    if (world_rank == 0 && Stats::enabled())
+        std::cout << Stats::snapshot().json() << std::endl;
+
+    MPI_Finalize();
+    return 0;
+}
@@ -131,6 +131,121 @@ namespace Bits {
             return this->length;
         }
     };
+
+    // Append lowest n bits of value, most significant bit first
+    inline void append(std::vector<bool> &bits, uint64_t value, unsigned n) {
+        while (n-- > 0)
+            bits.push_back((value >> n) & 1);
+    }
+
+    // Append lowest n bytes of value to byte buffer, most significant byte first
+    inline void put_bytes(std::vector<char> &bytes, uint64_t value, unsigned n) {
+        while (n-- > 0)
+            bytes.push_back(static_cast<char>((value >> (8 * n)) & 0xff));
+    }
+
+    // Read value of n bytes written by put_bytes
+    inline uint64_t get_bytes(const char *bytes, unsigned n) {
+        uint64_t value = 0;
+        for (unsigned index = 0; index < n; ++index)
+            value = (value << 8) | static_cast<uint8_t>(bytes[index]);
+        return value;
+    }
+
+    // Append Elias gamma code of value, value must be positive
+    //   assert(gamma(5) == std::vector({0, 0, 1, 0, 1}));
+    inline void append_gamma(std::vector<bool> &bits, uint64_t value) {
+        if (value == 0)
+            throw std::invalid_argument("gamma code of zero");
+        unsigned width = 0;
+        while (width < 63 && value >> (width + 1))
+            width++;
+        append(bits, 0, width);
+        append(bits, value, width + 1);
+    }
+
+    // Append any 64 bits value including zero and UINT64_MAX, where gamma(value + 1) would overflow:
+    //   gamma(width + 1), then value bits below its leading one (width is 0 for zero)
+    inline void append_natural(std::vector<bool> &bits, uint64_t value) {
+        unsigned width = 0;
+        while (width < 64 && value >> width)
+            width++;
+        append_gamma(bits, width + 1);
+        if (width > 1)
+            append(bits, value, width - 1);
+    }
+
+    // Read bits several at a time, bits are packed into 64 bits words once
+    // Reading after end gives zero bits so that table lookups near end are safe
+    class Reader {
+    private:
+        std::vector<uint64_t> words;
+        size_t length;
+        size_t cursor;
+
+    public:
+        explicit Reader(const std::vector<bool> &bits, size_t position = 0)
+                : words((bits.size() + 63) / 64, 0), length(bits.size()), cursor(position) {
+            for (size_t index = 0; index < bits.size(); ++index)
+                if (bits[index])
+                    this->words[index / 64] |= uint64_t(1) << (63 - index % 64);
+        }
+
+        // Next n bits (n <= 32) without consuming them
+        [[nodiscard]] uint32_t peek(unsigned n) const {
+            if (n == 0)
+                return 0;
+            size_t word = this->cursor / 64;
+            unsigned offset = this->cursor % 64;
+            uint64_t value = word < this->words.size() ? this->words[word] << offset : 0;
+            if (offset && word + 1 < this->words.size())
+                value |= this->words[word + 1] >> (64 - offset);
+            return static_cast<uint32_t>(value >> (64 - n));
+        }
+
+        void skip(unsigned n) {
+            this->cursor += n;
+            if (this->cursor > this->length)
+                throw std::length_error("read after end of bits");
+        }
+
+        uint64_t read(unsigned n) {
+            uint64_t value = 0;
+            while (n > 32) {
+                value = (value << 32) | this->peek(32);
+                this->skip(32);
+                n -= 32;
+            }
+            value = (value << n) | this->peek(n);
+            this->skip(n);
+            return value;
+        }
+
+        uint64_t gamma() {
+            unsigned width = 0;
+            while (!this->read(1))
+                if (++width > 63)
+                    throw std::length_error("invalid gamma code");
+            return (uint64_t(1) << width) | this->read(width);
+        }
+
+        uint64_t natural() {
+            auto width = this->gamma() - 1;
+            if (width > 64)
+                throw std::length_error("invalid natural code");
+            if (width == 0)
+                return 0;
+            return (uint64_t(1) << (width - 1)) | this->read(static_cast<unsigned>(width - 1));
+        }
+
+        [[nodiscard]] size_t position() const {
+            return this->cursor;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return this->length;
+        }
+    };
 }
 
 #endif //MPI_BITS_H
@@ -0,0 +1,218 @@
+#ifndef MPI_BLOCK_H
+#define MPI_BLOCK_H
+
+#include <cmath>
+
+#include "common.h"
+#include "bits.h"
+#include "huffman.h"
+#include "rle.h"
+#include "transport.h"
+
+// Self contained compressed block of bytes, used by file oriented tools
+// The format of compressed block is:
+//   length: uint64_t, mode: uint8_t, body depending on mode
+//     Raw:       length bytes as they are
+//     Single:    the only byte value of block
+//     RunLength: RLE encoded pairs of count and byte
+//     Entropy:   bits: uint64_t, packed bits of Huffman dict and content
+// An empty block is length 0 with Raw mode and no body.
+// Compressed file is a sequence of frames:
+//   size: uint64_t, compressed block
+// Integer fields are stored most significant byte first, so files are portable across machines.
+
+namespace Block {
+
+    enum Mode : uint8_t {
+        Raw = 0,
+        Single,
+        RunLength,
+        Entropy
+    };
+
+    template<typename Value>
+    void put(std::vector<char> &bytes, Value value) {
+        static_assert(std::is_integral<Value>::value || std::is_enum<Value>::value, "fields are integers");
+        Bits::put_bytes(bytes, static_cast<uint64_t>(value), sizeof(Value));
+    }
+
+    template<typename Value>
+    Value get(const std::vector<char> &bytes, size_t &offset) {
+        static_assert(std::is_integral<Value>::value || std::is_enum<Value>::value, "fields are integers");
+        if (offset + sizeof(Value) > bytes.size())
+            throw std::length_error("truncated block");
+        auto value = static_cast<Value>(Bits::get_bytes(bytes.data() + offset, sizeof(Value)));
+        offset += sizeof(Value);
+        return value;
+    }
+
+    // Pick block mode from byte histogram and run count in one pass:
+    // order 0 entropy plus dict size estimates Huffman output, two bytes per run estimates RLE,
+    // blocks neither would shrink are copied raw
+    template<class Iterator>
+    Mode choose(Iterator begin, Iterator end) {
+        static_assert(sizeof(typename std::iterator_traits<Iterator>::value_type) == 1,
+                      "blocks are byte streams");
+        uint64_t histogram[256] = {};
+        uint64_t runs = 0;
+        uint64_t length = 0;
+        uint8_t previous = 0;
+        uint8_t count = 0;
+        for (; begin != end; ++begin) {
+            auto current = static_cast<uint8_t>(*begin);
+            histogram[current]++;
+            if (length == 0 || current != previous || count == 255) {
+                runs++;
+                count = 0;
+            }
+            count++;
+            previous = current;
+            length++;
+        }
+
+        size_t distinct = 0;
+        double bits = 0.;
+        for (const auto &value: histogram) {
+            if (!value)
+                continue;
+            distinct++;
+            auto probability = static_cast<double>(value) / static_cast<double>(length);
+            bits -= static_cast<double>(value) * std::log2(probability);
+        }
+        if (distinct <= 1)
+            return length ? Single : Raw;
+
+        // Dict costs a count plus 40 bits per symbol, see serialize_frequency
+        double huffman = (bits + 64. + static_cast<double>(distinct) * 40.) / 8. + sizeof(uint64_t);
+        double rle = static_cast<double>(runs) * 2.;
+        auto raw = static_cast<double>(length);
+        if (rle < huffman && rle < raw)
+            return RunLength;
+        return huffman < raw * 0.98 ? Entropy : Raw;
+    }
+
+    // Compress into given buffer, its capacity is reused
+    template<class Iterator>
+    void compress(Iterator begin, Iterator end, std::vector<char> &compressed) {
+        compressed.clear();
+        auto length = static_cast<uint64_t>(std::distance(begin, end));
+        put<uint64_t>(compressed, length);
+        auto mode = choose(begin, end);
+        put<uint8_t>(compressed, mode);
+        switch (mode) {
+            case Single:
+                compressed.push_back(*begin);
+                return;
+            case RunLength:
+                RLE::encode(begin, end, std::back_inserter(compressed));
+                return;
+            case Entropy: {
+                Huffman::Encoder<char> encoder(begin, end);
+                auto bits = encoder.dict();
+                auto content = encoder.encode();
+                bits.insert(bits.end(), content.begin(), content.end());
+                // Estimate could be wrong on small blocks, never emit more than raw copy
+                if ((bits.size() + 7) / 8 + sizeof(uint64_t) < length) {
+                    put<uint64_t>(compressed, bits.size());
+                    auto packed = Transport::pack(bits);
+                    compressed.insert(compressed.end(), packed.begin(), packed.end());
+                    return;
+                }
+                compressed.back() = static_cast<char>(Raw);
+                break;
+            }
+            case Raw:
+                break;
+        }
+        compressed.insert(compressed.end(), begin, end);
+    }
+
+    template<class Iterator>
+    std::vector<char> compress(Iterator begin, Iterator end) {
+        std::vector<char> compressed;
+        compress(begin, end, compressed);
+        return compressed;
+    }
+
+    template<class Inserter>
+    void decompress(const std::vector<char> &compressed, Inserter inserter) {
+        size_t offset = 0;
+        auto length = get<uint64_t>(compressed, offset);
+        auto mode = get<uint8_t>(compressed, offset);
+        auto body = compressed.begin() + static_cast<long>(offset);
+        size_t remaining = compressed.size() - offset;
+
+        if (mode == Raw) {
+            if (remaining != length)
+                throw std::length_error("invalid block size");
+            std::copy(body, compressed.end(), inserter);
+            return;
+        }
+        if (mode == Single) {
+            if (remaining != 1)
+                throw std::length_error("invalid block size");
+            for (uint64_t index = 0; index < length; ++index)
+                inserter = *body;
+            return;
+        }
+
+        std::string decoded;
+        if (mode == RunLength) {
+            RLE::decode(body, compressed.end(), std::back_inserter(decoded));
+        } else if (mode == Entropy) {
+            auto count = get<uint64_t>(compressed, offset);
+            if ((count + 7) / 8 != compressed.size() - offset)
+                throw std::length_error("invalid block size");
+            std::vector<char> packed(compressed.begin() + static_cast<long>(offset), compressed.end());
+            std::vector<bool> bits;
+            Transport::unpack(packed, count, bits);
+            Huffman::Decoder<char> decoder(bits);
+            decoder.decode(std::back_inserter(decoded));
+        } else {
+            throw std::invalid_argument("invalid block mode");
+        }
+        if (decoded.size() != length)
+            throw std::length_error("invalid decoded size");
+        for (const auto &item: decoded)
+            inserter = item;
+    }
+
+    // Write one frame of compressed block to output stream
+    inline void write(std::ostream &output, const std::vector<char> &compressed) {
+        std::vector<char> size;
+        Bits::put_bytes(size, compressed.size(), sizeof(uint64_t));
+        output.write(size.data(), static_cast<std::streamsize>(size.size()));
+        output.write(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+    }
+
+    // Read one frame, return false at end of stream
+    inline bool read(std::istream &input, std::vector<char> &compressed) {
+        char buffer[sizeof(uint64_t)];
+        if (!input.read(buffer, sizeof(buffer)))
+            return false;
+        auto size = Bits::get_bytes(buffer, sizeof(buffer));
+        compressed.resize(size);
+        if (!input.read(compressed.data(), static_cast<std::streamsize>(size)))
+            throw std::length_error("truncated frame");
+        return true;
+    }
+
+    // Decompress every frame of source file into destination file
+    inline void decompress(const std::string &source, const std::string &destination) {
+        std::ifstream reader(source, std::ios::in | std::ios::binary);
+        if (!reader)
+            throw std::invalid_argument("cannot open " + source);
+        std::ofstream writer(destination, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!writer)
+            throw std::invalid_argument("cannot open " + destination);
+        std::vector<char> compressed;
+        std::string decoded;
+        while (read(reader, compressed)) {
+            decoded.clear();
+            decompress(compressed, std::back_inserter(decoded));
+            writer.write(decoded.data(), static_cast<std::streamsize>(decoded.size()));
+        }
+    }
+}
+
+#endif //MPI_BLOCK_H
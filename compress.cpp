@@ -0,0 +1,46 @@
+#include <iostream>
+
+#include "common.h"
+
+#include "block.h"
+#include "pipeline.h"
+
+// Compress one file with threaded reader, compression workers and ordered writer
+//   Usage: compress [--threads 4] [--block 1048576] [--buffers 10] <input file> <output file>
+//          compress --decompress <compressed file> <output file>
+// Statistics of stages and queues are printed as JSON, "bound" names the slowest stage.
+
+int main(int argc, char **argv) {
+    if (argc == 4 && std::string(argv[1]) == "--decompress") {
+        Block::decompress(argv[2], argv[3]);
+        return 0;
+    }
+
+    Pipeline::Options options;
+    std::vector<std::string> files;
+    for (int index = 1; index < argc; ++index) {
+        std::string key = argv[index];
+        if (key.rfind("--", 0) != 0) {
+            files.push_back(key);
+            continue;
+        }
+        if (index + 1 >= argc)
+            break;
+        std::string value = argv[++index];
+        if (key == "--threads")
+            options.workers = std::stoul(value);
+        else if (key == "--block")
+            options.block = std::stoul(value);
+        else if (key == "--buffers")
+            options.buffers = std::stoul(value);
+        else
+            throw std::invalid_argument("unknown option: " + key);
+    }
+    if (files.size() != 2) {
+        std::cerr << "Usage: compress [--threads n] [--block bytes] [--buffers n] <input> <output>" << std::endl;
+        return 1;
+    }
+
+    std::cout << Pipeline::compress(files[0], files[1], options).json() << std::endl;
+    return 0;
+}
@@ -0,0 +1,582 @@
+#include <chrono>
+#include <iostream>
+
+#include "common.h"
+
+#include "huffman.h"
+#include "rle.h"
+#include "wide.h"
+#include "lz77.h"
+#include "adaptive.h"
+#include "block.h"
+#include "pipeline.h"
+#include "service.h"
+#include "bench.h"
+
+// Differential tester of every engine on random and adversarial inputs
+//   Usage: mpirun -n <ranks> fuzz [--iterations 200] [--seed 1] [--max-size 100000] [--work /tmp]
+// Every input goes through serial, trained dictionary, threaded, service and MPI engines.
+// Decoded output must equal the input, and engines meant to emit the same bits (serial,
+// MPI and pipelined Huffman, RLE and LZ77 against serial coding of the same rank parts
+// and blocks, serial blocks against threaded and service frames) are compared bit for bit.
+// Every input, and a corrupted block of it, is also fed as is to every decoder, which
+// must either decode it or throw. Throughput of every engine is printed as JSON lines
+// at the end; the first mismatch aborts all ranks and saves the failing input as fuzz-failure.bin.
+// Built with -DFUZZING and -fsanitize=fuzzer it is a libFuzzer target of serial engines
+// and of decoders on arbitrary input.
+
+namespace Fuzz {
+
+    struct Engine {
+        size_t inputs = 0;
+        size_t bytes = 0;
+        double seconds = 0.;
+    };
+
+    inline std::map<std::string, Engine> &engines() {
+        static std::map<std::string, Engine> instance;
+        return instance;
+    }
+
+    // Run function and charge its time and input size to engine
+    template<class Function>
+    void timed(const std::string &name, size_t bytes, Function function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        auto &engine = engines()[name];
+        engine.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        engine.bytes += bytes;
+        engine.inputs++;
+    }
+
+    inline void expect(bool condition, const std::string &engine, const std::string &what) {
+        if (!condition)
+            throw std::runtime_error(engine + ": " + what);
+    }
+
+    // Serial engines, huffman bits are returned as reference of MPI engines
+    inline std::vector<bool> serial(const std::string &input) {
+        size_t n = input.size();
+        std::vector<bool> reference;
+
+        timed("huffman", n, [&]() {
+            Huffman::Encoder<char> encoder(input.begin(), input.end());
+            reference = encoder.dict();
+            auto content = encoder.encode();
+            reference.insert(reference.end(), content.begin(), content.end());
+            Huffman::Decoder<char> decoder(reference);
+            std::string decoded;
+            decoder.decode(std::back_inserter(decoded));
+            expect(decoded == input, "huffman", "decoded differs");
+        });
+
+        timed("wide", n, [&]() {
+            std::vector<uint16_t> tokens(input.begin(), input.end());
+            Huffman::WideEncoder<uint16_t> encoder(tokens.begin(), tokens.end());
+            auto bits = encoder.dict();
+            auto content = encoder.encode();
+            bits.insert(bits.end(), content.begin(), content.end());
+            Huffman::WideDecoder<uint16_t> decoder(bits);
+            std::vector<uint16_t> decoded;
+            decoder.decode(std::back_inserter(decoded));
+            expect(decoded == tokens, "wide", "decoded differs");
+        });
+
+        for (int level: {1, 6, 9}) {
+            auto name = "lz77_" + std::to_string(level);
+            timed(name, n, [&]() {
+                auto bits = LZ77::compress(input.begin(), input.end(), LZ77::preset(level));
+                std::string decoded;
+                LZ77::decompress(bits, std::back_inserter(decoded));
+                expect(decoded == input, name, "decoded differs");
+            });
+        }
+
+        // Short period forces many rebuilds, decoder is fed whole and in uneven chunks
+        timed("adaptive", n, [&]() {
+            Huffman::AdaptiveEncoder<char> encoder(256);
+            auto bits = encoder.encode(input.begin(), input.end());
+            Huffman::AdaptiveDecoder<char> whole(256);
+            std::string decoded;
+            whole.feed(bits, std::back_inserter(decoded));
+            expect(decoded == input && whole.aligned(), "adaptive", "decoded differs");
+
+            Huffman::AdaptiveDecoder<char> chunked(256);
+            std::string streamed;
+            for (size_t index = 0, step = 1; index < bits.size(); index += step, step = step % 97 + 1) {
+                std::vector<bool> chunk(bits.begin() + static_cast<long>(index),
+                                        bits.begin() + static_cast<long>(std::min(index + step, bits.size())));
+                chunked.feed(chunk, std::back_inserter(streamed));
+            }
+            expect(streamed == input && chunked.aligned(), "adaptive", "chunked decoding differs");
+        });
+
+        timed("rle", n, [&]() {
+            std::string encoded;
+            RLE::encode(input.begin(), input.end(), std::back_inserter(encoded));
+            std::string decoded;
+            RLE::decode(encoded.begin(), encoded.end(), std::back_inserter(decoded));
+            expect(decoded == input, "rle", "decoded differs");
+        });
+
+        // Dictionary trained on first half of input plus every byte value, records carry its id only
+        timed("dictionary", n, [&]() {
+            std::vector<char> alphabet;
+            for (int value = 0; value < 256; ++value)
+                alphabet.push_back(static_cast<char>(value));
+            auto dictionary = Huffman::Dictionary<char>::train(std::vector<std::string>{input.substr(0, n / 2)}, alphabet);
+            Huffman::Dictionary<char> loaded(dictionary.serialize());
+            expect(loaded.id == dictionary.id && loaded.frequency == dictionary.frequency,
+                   "dictionary", "reloaded dictionary differs");
+
+            Huffman::Encoder<char> encoder(input.begin(), input.end(), loaded);
+            auto bits = encoder.dict();
+            auto content = encoder.encode();
+            Huffman::Encoder<char> shared(dictionary);
+            expect(content == shared.encode(input.begin(), input.end()), "dictionary", "bits differ between encoders");
+            bits.insert(bits.end(), content.begin(), content.end());
+            Huffman::Decoder<char> decoder(bits, dictionary);
+            std::string decoded;
+            decoder.decode(std::back_inserter(decoded));
+            expect(decoded == input, "dictionary", "decoded differs");
+
+            // Record of another dictionary must be rejected by its id
+            auto other = Huffman::Dictionary<char>::train(std::vector<std::string>{std::string(n + 1000, 'z')}, alphabet);
+            bool rejected = false;
+            try {
+                Huffman::Decoder<char> wrong(bits, other);
+            } catch (const std::invalid_argument &) {
+                rejected = true;
+            }
+            expect(rejected, "dictionary", "record of another dictionary accepted");
+        });
+
+        timed("block", n, [&]() {
+            auto compressed = Block::compress(input.begin(), input.end());
+            std::string decoded;
+            Block::decompress(compressed, std::back_inserter(decoded));
+            expect(decoded == input, "block", "decoded differs");
+            auto mode = Block::choose(input.begin(), input.end());
+            expect(n == 0 || mode != Block::Raw || compressed.size() == n + 9, "block", "raw block grew");
+        });
+        return reference;
+    }
+
+    // Wide coding of symbols at the ends of the 64 bits range, where range and header arithmetic could wrap
+    inline void wide_edges() {
+        const uint64_t top = std::numeric_limits<uint64_t>::max();
+        std::vector<std::vector<uint64_t>> inputs = {
+                {0, top}, {top}, {top, top - 1, top}, {0, 1, top}, {uint64_t(1) << 63, 0}, {top - (1 << 20), top}};
+        for (const auto &tokens: inputs) {
+            Huffman::WideEncoder<uint64_t> encoder(tokens.begin(), tokens.end());
+            auto bits = encoder.dict();
+            auto content = encoder.encode();
+            bits.insert(bits.end(), content.begin(), content.end());
+            Huffman::WideDecoder<uint64_t> decoder(bits);
+            std::vector<uint64_t> decoded;
+            decoder.decode(std::back_inserter(decoded));
+            expect(decoded == tokens, "wide", "64 bits edge symbols differ");
+        }
+    }
+
+    // Output iterator refusing to grow past limit, so lengths claimed by arbitrary input cannot exhaust memory
+    template<typename T>
+    class Bounded {
+    private:
+        std::vector<T> *output;
+        size_t limit;
+
+    public:
+        using iterator_category = std::output_iterator_tag;
+        using value_type = void;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = void;
+
+        Bounded(std::vector<T> &output, size_t limit) : output(&output), limit(limit) {}
+
+        Bounded &operator=(const T &value) {
+            if (this->output->size() >= this->limit)
+                throw std::length_error("output limit reached");
+            this->output->push_back(value);
+            return *this;
+        }
+
+        Bounded &operator*() {
+            return *this;
+        }
+
+        Bounded &operator++() {
+            return *this;
+        }
+
+        Bounded &operator++(int) {
+            return *this;
+        }
+    };
+
+    // Feed arbitrary bytes to every decoder, a clean exception and a decoded output are both fine,
+    // a crash, a hang or a sanitizer report is a bug
+    inline void arbitrary(const std::string &input) {
+        const size_t limit = 1 << 24;
+        std::vector<bool> bits;
+        for (const auto &byte: input)
+            Bits::append(bits, static_cast<uint8_t>(byte), 8);
+        std::vector<char> bytes(input.begin(), input.end());
+
+        auto attempt = [](auto function) {
+            try {
+                function();
+            } catch (const std::exception &) {
+                // Rejected input
+            }
+        };
+        timed("arbitrary", input.size(), [&]() {
+            std::vector<char> output;
+            std::vector<uint16_t> tokens;
+            attempt([&]() {
+                Huffman::Decoder<char> decoder(bits);
+                decoder.decode(Bounded<char>(output, limit));
+            });
+            attempt([&]() {
+                Huffman::Dictionary<char> dictionary(bits);
+                Huffman::Decoder<char> decoder(dictionary);
+                decoder.decode(bits, Bounded<char>(output, limit));
+            });
+            attempt([&]() {
+                Huffman::WideDecoder<uint16_t> decoder(bits);
+                decoder.decode(Bounded<uint16_t>(tokens, limit));
+            });
+            attempt([&]() {
+                LZ77::decompress(bits, Bounded<char>(output, limit));
+            });
+            attempt([&]() {
+                Huffman::AdaptiveDecoder<char> decoder(256);
+                decoder.feed(bits, Bounded<char>(output, limit));
+            });
+            attempt([&]() {
+                RLE::decode(bytes.begin(), bytes.end(), Bounded<char>(output, limit));
+            });
+            attempt([&]() {
+                Block::decompress(bytes, Bounded<char>(output, limit));
+            });
+        });
+    }
+
+    // Compressed block of input with one byte flipped, reaches decoders past their headers
+    inline std::string corrupted(const std::string &input) {
+        auto compressed = Block::compress(input.begin(), input.end());
+        auto index = (compressed.size() * 7) / 11;
+        compressed[index] = static_cast<char>(compressed[index] ^ (1 << (input.size() % 8)));
+        return std::string(compressed.begin(), compressed.end());
+    }
+
+    // Frames of serial blocks of given size, as written by threaded pipeline and service
+    inline std::string frames(const std::string &input, size_t block) {
+        std::ostringstream expected;
+        for (size_t offset = 0; offset < input.size(); offset += block) {
+            auto stop = std::min(offset + block, input.size());
+            Block::write(expected, Block::compress(input.begin() + static_cast<long>(offset),
+                                                   input.begin() + static_cast<long>(stop)));
+        }
+        return expected.str();
+    }
+
+    inline std::string load(const std::string &path) {
+        std::ifstream reader(path, std::ios::in | std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(reader)), std::istreambuf_iterator<char>());
+    }
+
+    // Threaded pipeline must write the same frames as serial blocks of same size
+    inline void threaded(const std::string &input, const std::string &work) {
+        const size_t block = 4096;
+        auto source = work + "/fuzz-" + std::to_string(getpid()) + ".in";
+        auto destination = source + ".huff";
+        {
+            std::ofstream writer(source, std::ios::out | std::ios::trunc | std::ios::binary);
+            writer.write(input.data(), static_cast<std::streamsize>(input.size()));
+        }
+
+        timed("threaded", input.size(), [&]() {
+            Pipeline::Options options;
+            options.block = block;
+            options.workers = 3;
+            Pipeline::compress(source, destination, options);
+        });
+        auto written = load(destination);
+        std::remove(source.c_str());
+        std::remove(destination.c_str());
+        expect(written == frames(input, block), "threaded", "frames differ from serial blocks");
+    }
+
+#ifndef FUZZING
+
+    // Serial output of function over the same rank parts and blocks as MPI engines,
+    // block 0 takes every part whole
+    template<class Result, class Function>
+    Result split(const std::string &input, size_t block, Function function) {
+        int world_size;
+        MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+        size_t n = input.size();
+        size_t offset = n / world_size;
+        Result result;
+        for (int rank = 0; rank < world_size; ++rank) {
+            size_t start = rank * offset;
+            size_t stop = rank == world_size - 1 ? n : start + offset;
+            for (size_t first = start; first < stop;) {
+                size_t last = block ? std::min(first + block, stop) : stop;
+                auto part = function(input.begin() + static_cast<long>(first), input.begin() + static_cast<long>(last));
+                result.insert(result.end(), part.begin(), part.end());
+                first = last;
+            }
+        }
+        return result;
+    }
+
+    // Service compresses a spooled file on workers, its frames must equal serial blocks
+    // and restore the input through Block::decompress, every rank takes part
+    inline void service(const std::string &input, const std::string &work) {
+        int world_rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+        if (world_rank != 0) {
+            Service::worker();
+            return;
+        }
+
+        Service::Options options;
+        options.spool = work + "/fuzz-spool-" + std::to_string(getpid());
+        options.output = work + "/fuzz-output-" + std::to_string(getpid());
+        options.block = 4096;
+        options.once = true;
+        options.interval = 0;
+        std::filesystem::create_directories(options.spool);
+        {
+            std::ofstream writer(options.spool + "/input", std::ios::out | std::ios::trunc | std::ios::binary);
+            writer.write(input.data(), static_cast<std::streamsize>(input.size()));
+        }
+
+        // Job reports of manager are not part of fuzz output
+        std::ostringstream sink;
+        auto saved = std::cout.rdbuf(sink.rdbuf());
+        timed("service", input.size(), [&]() {
+            Service::Manager(options).run();
+        });
+        std::cout.rdbuf(saved);
+
+        auto compressed = options.output + "/input.huff";
+        auto restored = options.output + "/input.out";
+        auto written = load(compressed);
+        Block::decompress(compressed, restored);
+        auto decoded = load(restored);
+        std::filesystem::remove_all(options.spool);
+        std::filesystem::remove_all(options.output);
+        expect(written == frames(input, options.block), "service", "frames differ from serial blocks");
+        expect(decoded == input, "service", "decoded differs");
+    }
+
+    // MPI engines, every rank runs them with the same input
+    inline void parallel(const std::string &input, const std::vector<bool> &reference) {
+        size_t n = input.size();
+
+        Huffman::Encoder<char> encoder(input.begin(), input.end(), true);
+        auto dict = encoder.dict();
+        std::vector<bool> content;
+        timed("mpi_huffman", n, [&]() {
+            content = encoder.MPI_Encode(input.begin(), input.end());
+        });
+        auto bits = dict;
+        bits.insert(bits.end(), content.begin(), content.end());
+        expect(bits == reference, "mpi_huffman", "bits differ from serial");
+
+        timed("mpi_huffman_pipelined", n, [&]() {
+            content = encoder.MPI_Encode_pipelined(input.begin(), input.end(), 1000);
+        });
+        bits = dict;
+        bits.insert(bits.end(), content.begin(), content.end());
+        expect(bits == reference, "mpi_huffman_pipelined", "bits differ from serial");
+
+        // Serial RLE and LZ77 of every rank part (and block), concatenated
+        using Iterator = std::string::const_iterator;
+        auto rle = [](Iterator first, Iterator last) {
+            std::string encoded;
+            RLE::encode(first, last, std::back_inserter(encoded));
+            return encoded;
+        };
+        auto lz77 = [](Iterator first, Iterator last) {
+            return LZ77::compress(first, last, LZ77::preset(6));
+        };
+
+        std::string encoded;
+        timed("mpi_rle", n, [&]() {
+            RLE::MPI_Encode(input.begin(), input.end(), std::back_inserter(encoded));
+        });
+        expect(encoded == split<std::string>(input, 0, rle), "mpi_rle", "bytes differ from serial");
+        std::string decoded;
+        RLE::MPI_Decode(encoded.begin(), encoded.end(), std::back_inserter(decoded));
+        expect(decoded == input, "mpi_rle", "decoded differs");
+
+        encoded.clear();
+        timed("mpi_rle_pipelined", n, [&]() {
+            RLE::MPI_Encode_pipelined(input.begin(), input.end(), std::back_inserter(encoded), 1000);
+        });
+        expect(encoded == split<std::string>(input, 1000, rle), "mpi_rle_pipelined", "bytes differ from serial");
+        decoded.clear();
+        RLE::decode(encoded.begin(), encoded.end(), std::back_inserter(decoded));
+        expect(decoded == input, "mpi_rle_pipelined", "decoded differs");
+
+        timed("mpi_lz77", n, [&]() {
+            bits = LZ77::MPI_Compress(input.begin(), input.end(), LZ77::preset(6), 4096);
+        });
+        expect(bits == split<std::vector<bool>>(input, 4096, lz77), "mpi_lz77", "bits differ from serial");
+        decoded.clear();
+        LZ77::decompress(bits, std::back_inserter(decoded));
+        expect(decoded == input, "mpi_lz77", "decoded differs");
+    }
+
+#endif
+
+    // Inputs known to hit edge cases of run lengths, alphabets and tree shapes
+    inline std::vector<std::string> adversarial() {
+        std::vector<std::string> inputs = {"", "a", "ab", std::string(1, '\0'), std::string(2, '\xff')};
+        for (size_t length: {254, 255, 256, 257, 510, 511, 512, 70000})
+            inputs.emplace_back(length, 'x');
+        std::string bytes;
+        for (int value = 0; value < 256; ++value)
+            bytes.push_back(static_cast<char>(value));
+        inputs.push_back(bytes);
+        std::string repeated;
+        for (int copy = 0; copy < 40; ++copy)
+            repeated += bytes;
+        inputs.push_back(repeated);
+
+        // Runs of exactly 255 and 256 of alternating bytes
+        std::string runs;
+        for (int copy = 0; copy < 20; ++copy)
+            runs.append(copy % 2 ? 256 : 255, static_cast<char>('a' + copy % 3));
+        inputs.push_back(runs);
+
+        // One dominant symbol with a few rare ones, and Fibonacci counts for deepest trees
+        std::string skewed(20000, 'e');
+        for (size_t index = 0; index < skewed.size(); index += 997)
+            skewed[index] = static_cast<char>(index % 7);
+        inputs.push_back(skewed);
+        std::string fibonacci;
+        size_t previous = 1, current = 1;
+        for (int symbol = 0; symbol < 22; ++symbol) {
+            fibonacci.append(current, static_cast<char>('A' + symbol));
+            auto next = previous + current;
+            previous = current;
+            current = next;
+        }
+        inputs.push_back(fibonacci);
+        inputs.push_back(Bench::Profile::uniform(70000, 7));
+        return inputs;
+    }
+
+    // Random input mixing the benchmark profiles with random sizes
+    inline std::string random(std::mt19937 &generator, size_t limit) {
+        std::uniform_int_distribution<size_t> size(0, limit);
+        std::uniform_int_distribution<int> kind(0, 4);
+        auto n = size(generator);
+        auto seed = static_cast<uint32_t>(generator());
+        switch (kind(generator)) {
+            case 0:
+                return Bench::Profile::uniform(n, seed);
+            case 1:
+                return Bench::Profile::zipf(n, seed);
+            case 2:
+                return Bench::Profile::runs(n, seed);
+            case 3:
+                return Bench::Profile::text(n, "", seed);
+            default: {
+                // Few distinct bytes, sometimes only one
+                std::uniform_int_distribution<int> symbol(0, static_cast<int>(generator() % 3));
+                std::string result(n, 0);
+                for (auto &item: result)
+                    item = static_cast<char>(symbol(generator));
+                return result;
+            }
+        }
+    }
+}
+
+#ifdef FUZZING
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    std::string input(reinterpret_cast<const char *>(data), size);
+    Fuzz::serial(input);
+    Fuzz::arbitrary(input);
+    return 0;
+}
+
+#else
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+
+    int world_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+    size_t iterations = 200;
+    uint32_t seed = 1;
+    size_t limit = 100000;
+    std::string work = "/tmp";
+    for (int index = 1; index + 1 < argc; index += 2) {
+        std::string key = argv[index];
+        std::string value = argv[index + 1];
+        if (key == "--iterations")
+            iterations = std::stoul(value);
+        else if (key == "--seed")
+            seed = static_cast<uint32_t>(std::stoul(value));
+        else if (key == "--max-size")
+            limit = std::stoul(value);
+        else if (key == "--work")
+            work = value;
+        else
+            throw std::invalid_argument("unknown option: " + key);
+    }
+
+    // Every rank generates the same inputs
+    auto inputs = Fuzz::adversarial();
+    std::mt19937 generator(seed);
+    for (size_t iteration = 0; iteration < iterations; ++iteration)
+        inputs.push_back(Fuzz::random(generator, limit));
+
+    Fuzz::wide_edges();
+    for (size_t index = 0; index < inputs.size(); ++index) {
+        const auto &input = inputs[index];
+        try {
+            auto reference = Fuzz::serial(input);
+            if (world_rank == 0) {
+                Fuzz::threaded(input, work);
+                Fuzz::arbitrary(input);
+                Fuzz::arbitrary(Fuzz::corrupted(input));
+            }
+            Fuzz::service(input, work);
+            Fuzz::parallel(input, reference);
+        } catch (const std::exception &error) {
+            std::cerr << "rank " << world_rank << ", input " << index << " of size " << input.size() << ": "
+                      << error.what() << std::endl;
+            std::ofstream writer("fuzz-failure.bin", std::ios::out | std::ios::trunc | std::ios::binary);
+            writer.write(input.data(), static_cast<std::streamsize>(input.size()));
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    if (world_rank == 0) {
+        for (const auto &[name, engine]: Fuzz::engines())
+            std::cout << "{\"engine\":\"" << name << "\",\"ranks\":" << world_size << ",\"inputs\":" << engine.inputs
+                      << ",\"bytes\":" << engine.bytes << ",\"seconds\":" << engine.seconds
+                      << ",\"mb_per_second\":"
+                      << (engine.seconds > 0. ? static_cast<double>(engine.bytes) / 1e6 / engine.seconds : 0.)
+                      << "}" << std::endl;
+        std::cout << "{\"passed\":" << inputs.size() << ",\"ranks\":" << world_size << "}" << std::endl;
+    }
+
+    MPI_Finalize();
+    return 0;
+}
+
+#endif
@@ -4,15 +4,31 @@
 #include "common.h"
 
 namespace Heap {
-    template<typename T>
+    // Iterative d-ary min heap stored in one vector
+    // Elements are moved, never copied, while sifting; holes are used instead of swaps.
+    template<typename T, size_t Arity = 2, class Compare = std::less<T>>
     class MinHeap {
+        static_assert(Arity >= 2, "heap needs at least two children per node");
+
     private:
         std::vector<T> pool;
+        Compare less;
 
     public:
+        MinHeap() = default;
+
+        // Bulk construction in O(n)
+        explicit MinHeap(std::vector<T> elements, Compare compare = Compare())
+                : pool(std::move(elements)), less(compare) {
+            if (this->pool.size() < 2)
+                return;
+            for (size_t index = (this->pool.size() - 2) / Arity + 1; index-- > 0;)
+                this->sink(index);
+        }
+
         T &at(size_t index) {
             if (index < this->pool.size())
-                return this->pool.at(index);
+                return this->pool[index];
             throw std::out_of_range("invalid index");
         }
 
@@ -20,34 +36,51 @@ namespace Heap {
             return this->pool.size();
         }
 
+        [[nodiscard]] bool empty() const {
+            return this->pool.empty();
+        }
+
+        void reserve(size_t capacity) {
+            this->pool.reserve(capacity);
+        }
+
+        [[nodiscard]] const T &top() const {
+            if (this->pool.empty())
+                throw std::out_of_range("invalid index");
+            return this->pool.front();
+        }
+
     private:
         void float_(size_t index) {
-            if (index == 0)
-                return;
-            size_t current = index;
-            size_t father = (index - 1) / 2;
-            if (this->at(current) < this->at(father)) {
-                std::swap(this->at(current), this->at(father));
-                this->float_(father);
+            T element = std::move(this->pool[index]);
+            while (index > 0) {
+                size_t father = (index - 1) / Arity;
+                if (!this->less(element, this->pool[father]))
+                    break;
+                this->pool[index] = std::move(this->pool[father]);
+                index = father;
             }
+            this->pool[index] = std::move(element);
         }
 
         void sink(size_t index) {
-            size_t current = index;
-            size_t left = index * 2 + 1;
-            size_t right = left + 1;
-
-            // Check if only one child or no child of current node has
-            if (right >= this->pool.size())
-                right = left;
-            if (left >= this->pool.size())
-                return;
-
-            size_t minimal = this->at(left) <= this->at(right) ? left : right;
-            if (this->at(minimal) < this->at(current)) {
-                std::swap(this->at(minimal), this->at(current));
-                this->sink(minimal);
+            size_t n = this->pool.size();
+            T element = std::move(this->pool[index]);
+            while (true) {
+                size_t first = index * Arity + 1;
+                if (first >= n)
+                    break;
+                size_t last = std::min(first + Arity, n);
+                size_t minimal = first;
+                for (size_t child = first + 1; child < last; ++child)
+                    if (this->less(this->pool[child], this->pool[minimal]))
+                        minimal = child;
+                if (!this->less(this->pool[minimal], element))
+                    break;
+                this->pool[index] = std::move(this->pool[minimal]);
+                index = minimal;
             }
+            this->pool[index] = std::move(element);
         }
 
     public:
@@ -56,16 +89,40 @@ namespace Heap {
             this->float_(this->pool.size() - 1);
         }
 
+        void append(T &&element) {
+            this->pool.push_back(std::move(element));
+            this->float_(this->pool.size() - 1);
+        }
+
         T pop() {
-            if (this->pool.size() == 0)
+            if (this->pool.empty())
                 throw std::out_of_range("invalid index");
-            std::swap(this->at(0), this->at(this->pool.size() - 1));
-            const T element = this->pool.back();
-            this->pool.pop_back();
-            this->sink(0);
+            T element = std::move(this->pool.front());
+            if (this->pool.size() > 1) {
+                this->pool.front() = std::move(this->pool.back());
+                this->pool.pop_back();
+                this->sink(0);
+            } else {
+                this->pool.pop_back();
+            }
             return element;
         }
     };
+
+    // Entry of index heap, ties of key are broken by index so pop order is deterministic
+    template<typename Key>
+    struct Entry {
+        Key key;
+        uint32_t index;
+
+        bool operator<(const Entry &other) const {
+            return this->key < other.key || (!(other.key < this->key) && this->index < other.index);
+        }
+    };
+
+    // Heap of small key and index pairs, payloads stay in place in caller's storage
+    template<typename Key, size_t Arity = 4>
+    using IndexHeap = MinHeap<Entry<Key>, Arity>;
 }
 
 #endif //MPI_HEAP_H
@@ -5,6 +5,8 @@
 #include "heap.h"
 #include "bits.h"
 #include "utils.h"
+#include "transport.h"
+#include "stats.h"
 
 // Required element type T: Default constructor - T t;
 
@@ -23,18 +25,22 @@ namespace Huffman {
 
     public:
         DataType data;
-        float probability = 0.;
+        uint64_t weight = 0;
         Self *left = nullptr;
         Self *right = nullptr;
 
         // Default constructor for leaf node
-        Node(DataType d, float p) : data(d), probability(p) {}
+        Node(DataType d, uint64_t w) : data(d), weight(w) {}
 
-        // Merge two nodes as a new one with sum probabilities,
-        // make the less probability one as left child node
+        // Root over the only leaf of a one element alphabet, the leaf is its left child
+        // so that it gets one bit code and right child stays empty
+        explicit Node(Self *only) : data(only->data), weight(only->weight), left(only) {}
+
+        // Merge two nodes as a new one with sum weights,
+        // make the less weight one as left child node
         Node(Self *a, Self *b) {
-            this->probability = a->probability + b->probability;
-            if (a->probability <= b->probability) {
+            this->weight = a->weight + b->weight;
+            if (a->weight <= b->weight) {
                 this->left = a;
                 this->right = b;
             } else {
@@ -51,19 +57,21 @@ namespace Huffman {
 
         // Comparator
         bool operator<(const Self &other) const {
-            return this->probability < other.probability;
+            return this->weight < other.weight;
         }
 
         bool operator>(const Self &other) const {
-            return this->probability > other.probability;
+            return this->weight > other.weight;
         }
 
         bool operator<=(const Self &other) const {
-            return this->probability <= other.probability;
+            return this->weight <= other.weight;
         }
     };
 
     // Make a Huffman tree with analysed alphabet frequency mapping
+    // Weights are integers and ties are broken by creation order (leaves in key order,
+    // then merged nodes), so the same mapping builds the same tree on any machine
     template<typename T>
     class Tree {
     public:
@@ -72,23 +80,40 @@ namespace Huffman {
         std::vector<NodeT *> nodes;
 
     public:
-        explicit Tree(const std::map<T, float> &dict) {
-            Heap::MinHeap<NodeT> heap;
-            for (auto &kv: dict)
-                heap.append(NodeT(kv.first, kv.second));
+        explicit Tree(const std::map<T, uint64_t> &dict) {
+            HUFFMAN_CYCLES(Stats::Tree);
+            // Heap holds weight and index of node only, nodes never move
+            std::vector<Heap::Entry<uint64_t>> leaves;
+            leaves.reserve(dict.size());
+            this->nodes.reserve(dict.size() * 2);
+            for (auto &kv: dict) {
+                leaves.push_back({kv.second, static_cast<uint32_t>(this->nodes.size())});
+                this->nodes.push_back(new NodeT(kv.first, kv.second));
+            }
+            Heap::IndexHeap<uint64_t> heap(std::move(leaves));
+
+            // An empty mapping builds an empty tree without root, its code table is empty
+            if (heap.size() == 0)
+                return;
 
             // Merge until heap size equals to 1
-            while (heap.size() != 1) {
-                auto first = new NodeT(heap.pop());
-                auto second = new NodeT(heap.pop());
-                this->nodes.push_back(first);
-                this->nodes.push_back(second);
-                heap.append(NodeT(first, second));
+            while (heap.size() > 1) {
+                auto first = this->nodes[heap.pop().index];
+                auto second = this->nodes[heap.pop().index];
+                auto merged = new NodeT(first, second);
+                heap.append({merged->weight, static_cast<uint32_t>(this->nodes.size())});
+                this->nodes.push_back(merged);
             }
 
-            // Set root node
-            this->root = new NodeT(heap.pop());
-            this->nodes.push_back(this->root);
+            // Set root node, a one element alphabet (such as a block of one repeated byte)
+            // still needs an internal root for its leaf to get one bit code
+            this->root = this->nodes[heap.pop().index];
+            if (this->root->leaf()) {
+                this->root = new NodeT(this->root);
+                this->nodes.push_back(this->root);
+            }
+            HUFFMAN_STAT(Stats::add(Stats::TableBuilds, 1));
+            HUFFMAN_STAT(Stats::add(Stats::Allocations, this->nodes.size()));
         }
 
         ~Tree() {
@@ -97,10 +122,9 @@ namespace Huffman {
         }
 
         [[nodiscard]] std::map<T, std::vector<bool>> traverse() const {
-            if (this->root == nullptr)
-                throw std::invalid_argument("tree is not ready");
-
             std::map<T, std::vector<bool>> result;
+            if (this->root == nullptr)
+                return result;
 
             // Set unvisited nodes vector as pair made by node and its bit
             std::vector<std::pair<NodeT *, std::vector<bool>>> unvisited;
@@ -137,6 +161,7 @@ namespace Huffman {
     // Split this counting function out for make MPI concurrency easier
     template<class Iterator, typename T = typename std::iterator_traits<Iterator>::value_type>
     std::map<T, size_t> statistic(Iterator begin, Iterator end) {
+        HUFFMAN_CYCLES(Stats::Statistic);
         std::map<T, size_t> stats;
         while (begin != end) {
             const T &item = *begin;
@@ -162,9 +187,14 @@ namespace Huffman {
         int offset = static_cast<int>(n) / world_size;
         auto start = begin + world_rank * offset;
         auto stop = (world_rank == world_size - 1) ? end : start + offset;
-        std::map<T, size_t> part = statistic(start, stop);
+        std::map<T, size_t> part;
+        {
+            Profile::Scope scope(Profile::Statistic);
+            part = statistic(start, stop);
+        }
 
         // Send part to manager process
+        Profile::Scope scope(Profile::Reduce);
         if (world_rank == 0) {
             for (int source = 1; source < world_size; ++source) {
                 std::map<T, size_t> received = MPI_Receive_map<T, size_t>(source, 0);
@@ -193,13 +223,155 @@ namespace Huffman {
         return stats;
     }
 
+    // Normalize counts into 32 bits fixed point frequencies
+    // Counts are kept exact while their sum fits, otherwise all are shifted right by the same
+    // amount (rounding up to at least 1), integer only so every machine gets the same mapping
+    template<typename T>
+    std::map<T, uint32_t> normalize(const std::map<T, size_t> &stats) {
+        uint64_t total = 0;
+        for (const auto &pair: stats)
+            total += pair.second;
+        unsigned shift = 0;
+        while ((total >> shift) + stats.size() > UINT32_MAX)
+            shift++;
+        std::map<T, uint32_t> frequency;
+        for (const auto &pair: stats)
+            frequency[pair.first] = static_cast<uint32_t>(std::max<uint64_t>(pair.second >> shift, 1));
+        return frequency;
+    }
+
+    template<typename T>
+    std::map<T, uint64_t> weights(const std::map<T, uint32_t> &frequency) {
+        return std::map<T, uint64_t>(frequency.begin(), frequency.end());
+    }
+
+    // Keys of integral type are written most significant bit first, other types as raw bytes
+    template<typename T>
+    void append_key(std::vector<bool> &bits, const T &key) {
+        if constexpr (std::is_integral<T>::value) {
+            Bits::append(bits, static_cast<uint64_t>(key), sizeof(T) * 8);
+        } else {
+            auto raw = Bits::serialize<T>(key);
+            bits.insert(bits.end(), raw.begin(), raw.end());
+        }
+    }
+
+    template<typename T>
+    T read_key(Bits::Reader &reader) {
+        if constexpr (std::is_integral<T>::value) {
+            return static_cast<T>(reader.read(sizeof(T) * 8));
+        } else {
+            std::vector<bool> raw;
+            for (size_t index = 0; index < sizeof(T) * 8; ++index)
+                raw.push_back(reader.read(1));
+            return Bits::deserialize<T>(raw);
+        }
+    }
+
+    // Serialize frequency mapping, shared by inline dict and trained dictionary
+    // Every field has fixed width and is written most significant bit first,
+    // so the same mapping is read back on any machine. The format is:
+    //   count: 64 bits, first_element: T, first_frequency: 32 bits, ..., nth_element: T, nth_frequency: 32 bits
+    template<typename T>
+    std::vector<bool> serialize_frequency(const std::map<T, uint32_t> &frequency) {
+        std::vector<bool> encoded;
+        Bits::append(encoded, frequency.size(), 64);
+        for (const auto &pair: frequency) {
+            append_key(encoded, pair.first);
+            Bits::append(encoded, pair.second, 32);
+        }
+        return encoded;
+    }
+
+    // Recover frequency mapping from bits, reader will be moved after it
+    template<typename T>
+    std::map<T, uint32_t> deserialize_frequency(Bits::Reader &reader) {
+        std::map<T, uint32_t> frequency;
+        auto count = reader.read(64);
+        for (uint64_t index = 0; index < count; ++index) {
+            auto key = read_key<T>(reader);
+            frequency[key] = static_cast<uint32_t>(reader.read(32));
+        }
+        return frequency;
+    }
+
+    // Shared Huffman table trained from a corpus of samples
+    // Small records could be encoded with only the dictionary id as header,
+    // both sides must hold the same dictionary
+    template<typename T>
+    class Dictionary {
+    public:
+        uint32_t id = 0;
+        std::map<T, uint32_t> frequency;
+
+    public:
+        explicit Dictionary(const std::map<T, uint32_t> &frequency) : frequency(frequency) {
+            if (frequency.empty())
+                throw std::invalid_argument("empty dictionary");
+            this->id = Dictionary::checksum(serialize_frequency(frequency));
+        }
+
+        // Recover dictionary saved by serialize()
+        explicit Dictionary(const std::vector<bool> &bits) {
+            Bits::Reader reader(bits);
+            this->id = static_cast<uint32_t>(reader.read(32));
+            this->frequency = deserialize_frequency<T>(reader);
+            if (this->id != Dictionary::checksum(serialize_frequency(this->frequency)))
+                throw std::invalid_argument("corrupted dictionary");
+        }
+
+        // Count all samples together, every element in alphabet is counted once more
+        // so that records containing elements unseen in corpus are still encodable
+        template<class Container>
+        static Dictionary train(const std::vector<Container> &samples, const std::vector<T> &alphabet = {}) {
+            std::map<T, size_t> stats;
+            for (const auto &sample: samples)
+                for (const auto &item: sample)
+                    stats[item] += 1;
+            for (const auto &item: alphabet)
+                stats[item] += 1;
+            return Dictionary(normalize(stats));
+        }
+
+        // The format of serialized dictionary is:
+        //   id: 32 bits, frequency mapping (see serialize_frequency)
+        [[nodiscard]] std::vector<bool> serialize() const {
+            std::vector<bool> encoded;
+            Bits::append(encoded, this->id, 32);
+            auto table = serialize_frequency(this->frequency);
+            encoded.insert(encoded.end(), table.begin(), table.end());
+            return encoded;
+        }
+
+    private:
+        // FNV-1a over serialized frequency mapping
+        static uint32_t checksum(const std::vector<bool> &bits) {
+            uint32_t hash = 2166136261u;
+            for (size_t index = 0; index < bits.size(); index += 8) {
+                uint8_t byte = 0;
+                for (size_t offset = 0; offset < 8 && index + offset < bits.size(); ++offset)
+                    byte |= bits[index + offset] << (7 - offset);
+                hash = (hash ^ byte) * 16777619u;
+            }
+            return hash;
+        }
+    };
+
     template<typename T>
     class Encoder {
     private:
-        std::map<T, float> frequency;
+        std::map<T, uint32_t> frequency;
+        std::map<T, std::vector<bool>> codes;
         std::vector<T> data;
         Tree<T> *tree;
 
+        // Identifier of trained dictionary used instead of inline dict, 0 if not used
+        bool shared = false;
+        uint32_t identifier = 0;
+
+        // Price in 1/1000 bits, only computed for stats
+        uint64_t expected = 0;
+
     public:
         template<class Iterator>
         Encoder(Iterator begin, Iterator end, bool mpi = false) {
@@ -214,26 +386,38 @@ namespace Huffman {
                 stats = statistic(begin, end);
             else
                 stats = MPI_Statistic(begin, end);
-            auto total = static_cast<float>(this->data.size());
-            for (const auto &pair: stats)
-                this->frequency[pair.first] = static_cast<float>(pair.second) / total;
-            this->tree = new Tree<T>(this->frequency);
+            this->frequency = normalize(stats);
+            Profile::Scope scope(Profile::Tree);
+            this->tree = new Tree<T>(weights(this->frequency));
+            this->codes = this->tree->traverse();
+            HUFFMAN_STAT(this->expected = static_cast<uint64_t>(this->price() * 1000.f + .5f));
+        }
+
+        // Build encoder from trained dictionary, the tree is built only once
+        // so that many small records could be encoded with encode(begin, end)
+        explicit Encoder(const Dictionary<T> &dictionary)
+                : frequency(dictionary.frequency), shared(true), identifier(dictionary.id) {
+            this->tree = new Tree<T>(weights(this->frequency));
+            this->codes = this->tree->traverse();
+            HUFFMAN_STAT(this->expected = static_cast<uint64_t>(this->price() * 1000.f + .5f));
+        }
+
+        template<class Iterator>
+        Encoder(Iterator begin, Iterator end, const Dictionary<T> &dictionary) : Encoder(dictionary) {
+            static_assert(
+                    std::is_same<typename std::iterator_traits<Iterator>::value_type, T>::value,
+                    "iterator value type should as same as data type");
+            this->data.assign(begin, end);
         }
 
         // Encode dict into std::vector<bool> so it could be appended into head of file
-        // The format of encoded dict is:
-        //   count: size_t, first_element: T, first_frequency: float, ..., nth_element: T, nth_frequency: float
+        // See serialize_frequency for the format of encoded dict,
+        // when using trained dictionary only its id (32 bits) is encoded
         [[nodiscard]] std::vector<bool> dict() const {
+            if (!this->shared)
+                return serialize_frequency(this->frequency);
             std::vector<bool> encoded;
-            auto count = static_cast<size_t>(this->frequency.size());
-            for (const auto &bit: Bits::serialize<size_t>(count))
-                encoded.push_back(bit);
-            for (const auto &pair: this->frequency) {
-                for (const auto &bit: Bits::serialize<T>(pair.first))
-                    encoded.push_back(bit);
-                for (const auto &bit: Bits::serialize<float>(pair.second))
-                    encoded.push_back(bit);
-            }
+            Bits::append(encoded, this->identifier, 32);
             return encoded;
         }
 
@@ -241,13 +425,20 @@ namespace Huffman {
         // When encoding using MPI, it requests different part of container
         template<class Iterator>
         std::vector<bool> encode(Iterator begin, Iterator end) const {
-            auto dict = this->tree->traverse();
+            HUFFMAN_CYCLES(Stats::Encode);
+            HUFFMAN_STAT(uint64_t symbols = 0);
+            HUFFMAN_STAT(size_t capacity = 0);
             std::vector<bool> encoded;
             while (begin != end) {
-                for (const auto &bit: dict[*begin])
-                    encoded.push_back(bit);
+                auto found = this->codes.find(*begin);
+                if (found == this->codes.end())
+                    throw std::invalid_argument("element not in dictionary");
+                encoded.insert(encoded.end(), found->second.begin(), found->second.end());
+                HUFFMAN_STAT(Stats::grown(encoded.capacity(), capacity));
+                HUFFMAN_STAT(symbols++);
                 begin++;
             }
+            HUFFMAN_STAT(Stats::encoded(symbols, symbols * sizeof(T), encoded.size(), symbols * this->expected));
             return encoded;
         }
 
@@ -261,13 +452,16 @@ namespace Huffman {
                 delete this->tree;
         }
 
-        // Calculating encoding price:
-        //   sum([encoding_length] * [frequency])
+        // Calculating encoding price, average bits per element:
+        //   sum([encoding_length] * [frequency]) / sum([frequency])
         [[nodiscard]] float price() const {
-            float result = 0.;
-            for (const auto &pair: this->tree->traverse())
-                result += this->frequency.at(pair.first) * pair.second.size();
-            return result;
+            uint64_t bits = 0;
+            uint64_t total = 0;
+            for (const auto &pair: this->codes) {
+                bits += static_cast<uint64_t>(this->frequency.at(pair.first)) * pair.second.size();
+                total += this->frequency.at(pair.first);
+            }
+            return total ? static_cast<float>(static_cast<double>(bits) / static_cast<double>(total)) : 0.f;
         }
 
         // Rewrite encode function for using all nodes parallel
@@ -284,21 +478,29 @@ namespace Huffman {
             int offset = static_cast<int>(n) / world_size;
             auto start = begin + world_rank * offset;
             auto stop = (world_rank == world_size - 1) ? end : start + offset;
-            auto part = this->encode(start, stop);
+            std::vector<bool> part;
+            {
+                Profile::Scope scope(Profile::Encode);
+                part = this->encode(start, stop);
+            }
 
             // Send parts to manager process
             std::vector<bool> encoded;
-            if (world_rank == 0) {
-                encoded.assign(part.begin(), part.end());
-                for (int source = 1; source < world_size; ++source) {
-                    std::vector<bool> received = MPI_Receive_vector<bool>(source, 0);
-                    encoded.insert(encoded.end(), received.begin(), received.end());
+            {
+                Profile::Scope scope(Profile::Gather);
+                if (world_rank == 0) {
+                    encoded.assign(part.begin(), part.end());
+                    for (int source = 1; source < world_size; ++source) {
+                        std::vector<bool> received = MPI_Receive_vector<bool>(source, 0);
+                        encoded.insert(encoded.end(), received.begin(), received.end());
+                    }
+                } else {
+                    MPI_Send_vector(part, 0, 0);
                 }
-            } else {
-                MPI_Send_vector(part, 0, 0);
             }
 
             // Synchronizing from manager node to worker nodes
+            Profile::Scope scope(Profile::Broadcast);
             if (world_rank == 0) {
                 for (int dest = 1; dest < world_size; ++dest)
                     MPI_Send_vector(encoded, dest, 2);
@@ -307,60 +509,72 @@ namespace Huffman {
             }
             return encoded;
         }
+
+        // Pipelined version of MPI_Encode, blocks of every process are sent while
+        // the next one is encoded, see Transport::MPI_Encode_pipelined
+        template<class Iterator>
+        std::vector<bool> MPI_Encode_pipelined(Iterator begin, Iterator end,
+                                               size_t block = Transport::BlockSize) const {
+            return Transport::MPI_Encode_pipelined(begin, end, block, [this](Iterator first, Iterator last) {
+                return this->encode(first, last);
+            });
+        }
     };
 
     template<typename T>
     class Decoder {
     private:
         Tree<T> *tree;
-        std::map<T, float> frequency;
+        std::map<T, uint32_t> frequency;
         std::vector<bool> data;
 
     public:
         explicit Decoder(const std::vector<bool> &bits) {
-            std::vector<bool> part;
-            auto iterator = bits.begin();
-
-            // Get total element type count
-            part.assign(iterator, iterator + sizeof(size_t) * 8);
-            iterator += sizeof(size_t) * 8;
-            auto count = Bits::deserialize<size_t>(part);
-            part.clear();
-
-            // Recover saved frequency mapping
-            for (size_t index = 0; index < count; ++index) {
-                part.assign(iterator, iterator + sizeof(T) * 8);
-                iterator += sizeof(T) * 8;
-                auto key = Bits::deserialize<T>(part);
-                part.clear();
-                part.assign(iterator, iterator + sizeof(float) * 8);
-                iterator += sizeof(float) * 8;
-                auto value = Bits::deserialize<float>(part);
-                part.clear();
-                this->frequency[key] = value;
-            }
+            Bits::Reader reader(bits);
+            this->frequency = deserialize_frequency<T>(reader);
 
             // Rebuild Huffman tree
-            this->tree = new Tree<T>(this->frequency);
+            this->tree = new Tree<T>(weights(this->frequency));
 
             // Save encoded data
-            this->data.assign(iterator, bits.end());
+            this->data.assign(bits.begin() + static_cast<long>(reader.position()), bits.end());
+        }
+
+        // Build decoder from trained dictionary, records are decoded with decode(bits, inserter)
+        explicit Decoder(const Dictionary<T> &dictionary) : frequency(dictionary.frequency) {
+            this->tree = new Tree<T>(weights(this->frequency));
+        }
+
+        // Decode bits whose header is dictionary id instead of inline dict
+        Decoder(const std::vector<bool> &bits, const Dictionary<T> &dictionary) : Decoder(dictionary) {
+            Bits::Reader reader(bits);
+            if (reader.read(32) != dictionary.id)
+                throw std::invalid_argument("dictionary id mismatch");
+            this->data.assign(bits.begin() + static_cast<long>(reader.position()), bits.end());
         }
 
         // Decode data using Huffman tree
         template<class Inserter>
         void decode(const std::vector<bool> &bits, Inserter inserter) const {
+            HUFFMAN_CYCLES(Stats::Decode);
+            HUFFMAN_STAT(uint64_t symbols = 0);
             Node<T> *current = this->tree->root;
+            if (current == nullptr && !bits.empty())
+                throw std::invalid_argument("invalid code");
             for (const auto &bit: bits) {
-                if (bit == Left)
-                    current = current->left;
-                if (bit == Right)
-                    current = current->right;
+                // Root of a one element tree has no right child, see Node(Self *only),
+                // corrupted bits must not follow a missing child
+                auto next = bit == Left ? current->left : current->right;
+                if (next == nullptr)
+                    throw std::invalid_argument("invalid code");
+                current = next;
                 if (current->leaf()) {
                     inserter = current->data;
                     current = this->tree->root;
+                    HUFFMAN_STAT(symbols++);
                 }
             }
+            HUFFMAN_STAT(Stats::decoded(symbols, (bits.size() + 7) / 8, symbols * sizeof(T)));
         }
 
         // Decode given data by default
@@ -0,0 +1,237 @@
+#ifndef MPI_LZ77_H
+#define MPI_LZ77_H
+
+#include "common.h"
+#include "bits.h"
+#include "wide.h"
+#include "profile.h"
+#include "transport.h"
+
+// LZ77 front end of Huffman coding for byte streams
+// Matches are found with hash chains inside a sliding window, the block is turned into
+// literal / length symbols and distance symbols which are entropy coded by WideEncoder.
+// Lengths and distances are bucketed by bit width, low bits are stored as extra bits.
+// The format of compressed block is:
+//   gamma(n + 1), literal / length dict and content, distance dict and content,
+//   gamma(extra bits + 1), extra bits
+// Blocks are self delimiting so compressed blocks could be concatenated.
+
+namespace LZ77 {
+
+    static const size_t MinMatch = 3;
+    static const size_t MaxMatch = 258;
+    static const uint16_t LengthBase = 256;
+
+    // Compression level, larger window and longer chains trade speed for ratio
+    struct Level {
+        size_t window;      // power of two, longest distance of matches
+        size_t chain;       // candidates visited per position
+        size_t nice;        // stop searching when match reaches this length
+        bool lazy;          // try match at next position before taking current one
+    };
+
+    // Presets from 1 (fastest) to 9 (best ratio)
+    inline Level preset(int level) {
+        static const Level levels[] = {
+                {1 << 12, 4, 16, false},
+                {1 << 13, 8, 32, false},
+                {1 << 14, 16, 32, false},
+                {1 << 15, 16, 64, true},
+                {1 << 15, 32, 128, true},
+                {1 << 15, 128, 128, true},
+                {1 << 16, 256, MaxMatch, true},
+                {1 << 16, 512, MaxMatch, true},
+                {1 << 16, 4096, MaxMatch, true}};
+        return levels[std::clamp(level, 1, 9) - 1];
+    }
+
+    // Symbols of one block in emitted order
+    struct Tokens {
+        std::vector<uint16_t> symbols;      // literal byte, or LengthBase + length bucket
+        std::vector<uint16_t> distances;    // distance bucket of every match
+        std::vector<bool> extra;            // low bits of length and distance of every match
+    };
+
+    // Bit width of positive value, used as bucket of lengths and distances
+    inline unsigned width(uint32_t value) {
+        unsigned result = 0;
+        while (value >> result)
+            result++;
+        return result;
+    }
+
+    // Parse block into literals and matches using hash chain match finder
+    template<class Iterator>
+    Tokens parse(Iterator begin, Iterator end, const Level &level) {
+        static_assert(sizeof(typename std::iterator_traits<Iterator>::value_type) == 1,
+                      "LZ77 works on byte streams");
+        static const unsigned HashBits = 15;
+
+        std::vector<uint8_t> data(begin, end);
+        const long n = static_cast<long>(data.size());
+        const long window = static_cast<long>(level.window);
+        std::vector<long> head(size_t(1) << HashBits, -1);
+        std::vector<long> previous(level.window, -1);
+
+        auto hash = [&](long position) {
+            uint32_t value = data[position] | (data[position + 1] << 8) | (data[position + 2] << 16);
+            return (value * 2654435761u) >> (32 - HashBits);
+        };
+        auto insert = [&](long position) {
+            if (position + static_cast<long>(MinMatch) > n)
+                return;
+            auto key = hash(position);
+            previous[position & (window - 1)] = head[key];
+            head[key] = position;
+        };
+        // Longest match of position among inserted positions
+        auto find = [&](long position, size_t &distance) {
+            size_t best = 0;
+            if (position + static_cast<long>(MinMatch) > n)
+                return best;
+            size_t limit = std::min<size_t>(MaxMatch, n - position);
+            long candidate = head[hash(position)];
+            for (size_t chain = level.chain; candidate >= 0 && chain > 0; --chain) {
+                if (candidate >= position || position - candidate > window)
+                    break;
+                size_t length = 0;
+                while (length < limit && data[candidate + length] == data[position + length])
+                    length++;
+                if (length > best) {
+                    best = length;
+                    distance = position - candidate;
+                    if (length >= level.nice)
+                        break;
+                }
+                long next = previous[candidate & (window - 1)];
+                if (next >= candidate)
+                    break;
+                candidate = next;
+            }
+            return best >= MinMatch ? best : 0;
+        };
+
+        Tokens tokens;
+        long position = 0;
+        while (position < n) {
+            size_t distance = 0;
+            size_t length = find(position, distance);
+            if (length && level.lazy && length < level.nice) {
+                insert(position);
+                size_t later_distance = 0;
+                if (find(position + 1, later_distance) > length) {
+                    tokens.symbols.push_back(data[position]);
+                    position++;
+                    continue;
+                }
+            } else {
+                insert(position);
+            }
+
+            if (!length) {
+                tokens.symbols.push_back(data[position]);
+                position++;
+                continue;
+            }
+
+            auto value = static_cast<uint32_t>(length - MinMatch + 1);
+            auto bucket = width(value);
+            tokens.symbols.push_back(static_cast<uint16_t>(LengthBase + bucket - 1));
+            Bits::append(tokens.extra, value, bucket - 1);
+            bucket = width(static_cast<uint32_t>(distance));
+            tokens.distances.push_back(static_cast<uint16_t>(bucket - 1));
+            Bits::append(tokens.extra, distance, bucket - 1);
+            for (long skipped = position + 1; skipped < position + static_cast<long>(length); ++skipped)
+                insert(skipped);
+            position += static_cast<long>(length);
+        }
+        return tokens;
+    }
+
+    template<class Iterator>
+    std::vector<bool> compress(Iterator begin, Iterator end, const Level &level = preset(6)) {
+        auto tokens = parse(begin, end, level);
+        std::vector<bool> encoded;
+        Bits::append_gamma(encoded, static_cast<uint64_t>(std::distance(begin, end)) + 1);
+
+        Huffman::WideEncoder<uint16_t> symbols(tokens.symbols.begin(), tokens.symbols.end());
+        for (const auto &part: {symbols.dict(), symbols.encode()})
+            encoded.insert(encoded.end(), part.begin(), part.end());
+        Huffman::WideEncoder<uint16_t> distances(tokens.distances.begin(), tokens.distances.end());
+        for (const auto &part: {distances.dict(), distances.encode()})
+            encoded.insert(encoded.end(), part.begin(), part.end());
+
+        Bits::append_gamma(encoded, tokens.extra.size() + 1);
+        encoded.insert(encoded.end(), tokens.extra.begin(), tokens.extra.end());
+        return encoded;
+    }
+
+    // Decompress one block from reader, reader is left after it
+    template<class Inserter>
+    void decompress(Bits::Reader &reader, Inserter inserter) {
+        auto n = reader.gamma() - 1;
+
+        Tokens tokens;
+        Huffman::WideDecoder<uint16_t> symbols(reader);
+        symbols.decode(reader, std::back_inserter(tokens.symbols));
+        Huffman::WideDecoder<uint16_t> distances(reader);
+        distances.decode(reader, std::back_inserter(tokens.distances));
+        auto count = reader.gamma() - 1;
+        auto finish = reader.position() + count;
+        if (finish > reader.size())
+            throw std::length_error("truncated extra bits");
+
+        // Claimed size of corrupted input could be huge, reserve what tokens plausibly produce
+        // and check output against claimed size while it grows
+        std::vector<uint8_t> output;
+        output.reserve(std::min<uint64_t>(n, tokens.symbols.size() * (MaxMatch + 1)));
+        size_t match = 0;
+        for (const auto &symbol: tokens.symbols) {
+            if (symbol < LengthBase) {
+                if (output.size() >= n)
+                    throw std::length_error("invalid decoded size");
+                output.push_back(static_cast<uint8_t>(symbol));
+                continue;
+            }
+            unsigned bucket = symbol - LengthBase;
+            if (match >= tokens.distances.size() || bucket > 8 || tokens.distances[match] > 16)
+                throw std::invalid_argument("invalid match");
+            size_t length = ((size_t(1) << bucket) | reader.read(bucket)) + MinMatch - 1;
+            bucket = tokens.distances[match++];
+            size_t distance = (size_t(1) << bucket) | reader.read(bucket);
+            if (distance > output.size())
+                throw std::invalid_argument("invalid match");
+            if (length > n - output.size())
+                throw std::length_error("invalid decoded size");
+            // Copy byte by byte, source may overlap the bytes being written
+            size_t source = output.size() - distance;
+            for (size_t index = 0; index < length; ++index)
+                output.push_back(output[source + index]);
+        }
+        if (output.size() != n || reader.position() != finish)
+            throw std::length_error("invalid decoded size");
+
+        for (const auto &item: output)
+            inserter = static_cast<char>(item);
+    }
+
+    // Decompress every concatenated block
+    template<class Inserter>
+    void decompress(const std::vector<bool> &bits, Inserter inserter) {
+        Bits::Reader reader(bits);
+        while (reader.position() < reader.size())
+            decompress(reader, inserter);
+    }
+
+    // Every process compresses its part block by block and posts blocks asynchronously,
+    // manager concatenates blocks of all processes and broadcasts the result
+    template<class Iterator>
+    std::vector<bool> MPI_Compress(Iterator begin, Iterator end, const Level &level = preset(6),
+                                   size_t block = Transport::BlockSize) {
+        return Transport::MPI_Encode_pipelined(begin, end, block, [&level](Iterator first, Iterator last) {
+            return compress(first, last, level);
+        });
+    }
+}
+
+#endif //MPI_LZ77_H
@@ -5,6 +5,7 @@
 #include "huffman.h"
 #include "bits.h"
 #include "rle.h"
+#include "lz77.h"
 #include "utils.h"
 
 static const size_t RandomStringLength = 100;
@@ -29,12 +30,18 @@ int main() {
     RLE::MPI_Encode(source.begin(), source.end(), std::back_inserter(rle_encoded));
     RLE::MPI_Decode(rle_encoded.begin(), rle_encoded.end(), std::back_inserter(rle_decoded));
 
+    // LZ77 encoding with Huffman back end using MPI concurrently
+    std::string lz77_decoded;
+    auto lz77_encoded = LZ77::MPI_Compress(source.begin(), source.end());
+    LZ77::decompress(lz77_encoded, std::back_inserter(lz77_decoded));
+
     // Huffman encoding
     Huffman::Encoder<char> encoder(source.begin(), source.end(), true);
     auto dict = encoder.dict();
     auto content = encoder.MPI_Encode(source.begin(), source.end());
     if (world_rank == 0) {
         std::cout << "RLE encoded string size: " << rle_encoded.size() * 8 << std::endl;
+        std::cout << "LZ77 encoded string size: " << lz77_encoded.size() << std::endl;
         std::cout << "Source string size: " << source.size() * 8 << std::endl;
         std::cout << "Huffman encoding price: " << encoder.price() << std::endl;
         std::cout << "Huffman encoding dict size: " << dict.size() << std::endl;
@@ -50,7 +57,7 @@ int main() {
 
     // Show result
     if (world_rank == 0) {
-        if (source == decoded && source == rle_decoded)
+        if (source == decoded && source == rle_decoded && source == lz77_decoded)
             std::cout << "\nDecoded string equals to source one." << std::endl;
         else
             std::cout << "\nFailed." << std::endl;
@@ -79,6 +86,12 @@ int main() {
     RLE::decode(rle_encoded.begin(), rle_encoded.end(), std::back_inserter(rle_decoded));
     std::cout << "RLE encoded string size: " << rle_encoded.size() * 8 << std::endl;
 
+    // LZ77 encoding with Huffman back end
+    std::string lz77_decoded;
+    auto lz77_encoded = LZ77::compress(source.begin(), source.end());
+    LZ77::decompress(lz77_encoded, std::back_inserter(lz77_decoded));
+    std::cout << "LZ77 encoded string size: " << lz77_encoded.size() << std::endl;
+
     // Huffman encoding
     Huffman::Encoder<char> encoder(source.begin(), source.end());
     auto dict = encoder.dict();
@@ -110,7 +123,7 @@ int main() {
     std::cout << "Recovered from file: " << SavingToFile << std::endl;
 
     // Check if recovered string equals to source one
-    if (source == decoded && source == rle_decoded)
+    if (source == decoded && source == rle_decoded && source == lz77_decoded)
         std::cout << "\nDecoded string equals to source one." << std::endl;
     else
         std::cout << "\nFailed." << std::endl;
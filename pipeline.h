@@ -0,0 +1,350 @@
+#ifndef MPI_PIPELINE_H
+#define MPI_PIPELINE_H
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <sstream>
+#include <exception>
+#include <condition_variable>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "block.h"
+
+// Threaded file compression: reader -> compression workers -> ordered writer
+// Reader prefetches blocks with pread into buffers taken from a fixed pool, workers
+// compress them, writer puts frames out in input order and returns buffers to the pool.
+// The pool bounds memory, a stage that falls behind stalls the stage before it, and
+// per stage busy time and queue depths show which stage bounds the job.
+// Output uses the same frame format as Block::write, so it is readable by Block::read.
+// io_uring is not used, pread with sequential readahead advice keeps the reader portable.
+
+namespace Pipeline {
+
+    struct Options {
+        size_t block = 1 << 20;     // input bytes per block
+        size_t workers = std::max(1u, std::thread::hardware_concurrency());
+        size_t buffers = 0;         // pool size, 0 for twice the workers plus two
+    };
+
+    // Block buffer recycled through the pool, both vectors keep their capacity
+    struct Buffer {
+        uint64_t index = 0;
+        std::vector<char> data;
+        std::vector<char> compressed;
+    };
+
+    // Blocking queue, depth is sampled on every push
+    template<typename T>
+    class Queue {
+    private:
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<T> items;
+        bool closed = false;
+        size_t samples = 0;
+        size_t total = 0;
+        size_t deepest = 0;
+
+    public:
+        void push(T item) {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->items.push_back(std::move(item));
+                this->samples++;
+                this->total += this->items.size();
+                this->deepest = std::max(this->deepest, this->items.size());
+            }
+            this->ready.notify_one();
+        }
+
+        // Wait for an item, return false once closed and drained
+        bool pop(T &item) {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->ready.wait(lock, [this]() { return !this->items.empty() || this->closed; });
+            if (this->items.empty())
+                return false;
+            item = std::move(this->items.front());
+            this->items.pop_front();
+            return true;
+        }
+
+        void close() {
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                this->closed = true;
+            }
+            this->ready.notify_all();
+        }
+
+        [[nodiscard]] double mean_depth() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->samples ? static_cast<double>(this->total) / static_cast<double>(this->samples) : 0.;
+        }
+
+        [[nodiscard]] size_t max_depth() {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            return this->deepest;
+        }
+    };
+
+    // Busy and waiting seconds of a stage, summed over its threads
+    struct Stage {
+        double busy = 0.;
+        double waiting = 0.;
+        size_t threads = 1;
+
+        // Share of wall time the stage threads were working
+        [[nodiscard]] double utilization(double seconds) const {
+            return seconds > 0. ? this->busy / (seconds * static_cast<double>(this->threads)) : 0.;
+        }
+    };
+
+    struct Report {
+        size_t bytes_in = 0;
+        size_t bytes_out = 0;
+        size_t blocks = 0;
+        size_t buffers = 0;
+        double seconds = 0.;
+        Stage reader, workers, writer;
+        double filled_mean = 0., done_mean = 0., idle_mean = 0.;
+        size_t filled_max = 0, done_max = 0, idle_max = 0;
+
+        // Stage with highest utilization bounds the job
+        [[nodiscard]] std::string bound() const {
+            double read = this->reader.utilization(this->seconds);
+            double compress = this->workers.utilization(this->seconds);
+            double write = this->writer.utilization(this->seconds);
+            if (compress >= read && compress >= write)
+                return "cpu";
+            return read >= write ? "read" : "write";
+        }
+
+        [[nodiscard]] std::string json() const {
+            std::ostringstream stream;
+            auto stage = [&](const char *name, const Stage &value) {
+                stream << "\"" << name << "\":{\"threads\":" << value.threads
+                       << ",\"busy_seconds\":" << value.busy << ",\"waiting_seconds\":" << value.waiting
+                       << ",\"utilization\":" << value.utilization(this->seconds) << "}";
+            };
+            stream << "{\"bytes_in\":" << this->bytes_in << ",\"bytes_out\":" << this->bytes_out
+                   << ",\"blocks\":" << this->blocks << ",\"buffers\":" << this->buffers
+                   << ",\"seconds\":" << this->seconds << ",\"mb_per_second\":"
+                   << (this->seconds > 0. ? static_cast<double>(this->bytes_in) / 1e6 / this->seconds : 0.)
+                   << ",\"stages\":{";
+            stage("reader", this->reader);
+            stream << ",";
+            stage("workers", this->workers);
+            stream << ",";
+            stage("writer", this->writer);
+            stream << "},\"queues\":{\"filled\":{\"mean\":" << this->filled_mean << ",\"max\":" << this->filled_max
+                   << "},\"done\":{\"mean\":" << this->done_mean << ",\"max\":" << this->done_max
+                   << "},\"idle\":{\"mean\":" << this->idle_mean << ",\"max\":" << this->idle_max
+                   << "}},\"bound\":\"" << this->bound() << "\"}";
+            return stream.str();
+        }
+    };
+
+    class Compressor {
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        Options options;
+        std::vector<Buffer> pool;
+        Queue<Buffer *> idle;       // empty buffers for reader
+        Queue<Buffer *> filled;     // read blocks for workers
+        Queue<Buffer *> done;       // compressed blocks for writer
+        std::atomic<size_t> running{0};
+        std::mutex failure_mutex;
+        std::exception_ptr failure;
+        Report report;
+
+        static double since(Clock::time_point start) {
+            return std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        // Remember first error and unblock every stage
+        void fail() {
+            {
+                std::lock_guard<std::mutex> lock(this->failure_mutex);
+                if (!this->failure)
+                    this->failure = std::current_exception();
+            }
+            this->idle.close();
+            this->filled.close();
+            this->done.close();
+        }
+
+        void read(int descriptor) {
+            try {
+                Stage stage;
+                uint64_t index = 0;
+                off_t offset = 0;
+                while (true) {
+                    Buffer *buffer;
+                    auto start = Clock::now();
+                    if (!this->idle.pop(buffer))
+                        break;
+                    stage.waiting += since(start);
+
+                    start = Clock::now();
+                    buffer->data.resize(this->options.block);
+                    size_t length = 0;
+                    while (length < buffer->data.size()) {
+                        auto count = pread(descriptor, buffer->data.data() + length, buffer->data.size() - length,
+                                           offset + static_cast<off_t>(length));
+                        if (count < 0 && errno == EINTR)
+                            continue;
+                        if (count < 0)
+                            throw std::runtime_error("read failed");
+                        if (count == 0)
+                            break;
+                        length += count;
+                    }
+                    stage.busy += since(start);
+                    if (length == 0) {
+                        this->idle.push(buffer);
+                        break;
+                    }
+                    buffer->data.resize(length);
+                    buffer->index = index++;
+                    offset += static_cast<off_t>(length);
+                    this->report.bytes_in += length;
+                    this->filled.push(buffer);
+                }
+                this->report.reader = stage;
+                this->filled.close();
+            } catch (...) {
+                this->fail();
+            }
+        }
+
+        void work(Stage &stage) {
+            try {
+                while (true) {
+                    Buffer *buffer;
+                    auto start = Clock::now();
+                    if (!this->filled.pop(buffer))
+                        break;
+                    stage.waiting += since(start);
+
+                    start = Clock::now();
+                    Block::compress(buffer->data.begin(), buffer->data.end(), buffer->compressed);
+                    stage.busy += since(start);
+                    this->done.push(buffer);
+                }
+            } catch (...) {
+                this->fail();
+            }
+            // Last worker leaving closes writer queue
+            if (--this->running == 0)
+                this->done.close();
+        }
+
+        // Write compressed blocks in input order, runs on calling thread
+        void write(std::ostream &output) {
+            Stage stage;
+            std::map<uint64_t, Buffer *> pending;
+            uint64_t next = 0;
+            while (true) {
+                Buffer *buffer;
+                auto start = Clock::now();
+                if (!this->done.pop(buffer))
+                    break;
+                stage.waiting += since(start);
+
+                start = Clock::now();
+                pending[buffer->index] = buffer;
+                for (auto found = pending.find(next); found != pending.end(); found = pending.find(next)) {
+                    Block::write(output, found->second->compressed);
+                    this->report.bytes_out += found->second->compressed.size() + sizeof(uint64_t);
+                    this->report.blocks++;
+                    this->idle.push(found->second);
+                    pending.erase(found);
+                    next++;
+                }
+                if (!output)
+                    throw std::runtime_error("write failed");
+                stage.busy += since(start);
+            }
+            this->report.writer = stage;
+        }
+
+    public:
+        explicit Compressor(const Options &options) : options(options) {
+            if (this->options.block == 0)
+                throw std::invalid_argument("block size should be positive");
+            this->options.workers = std::max<size_t>(this->options.workers, 1);
+            if (this->options.buffers == 0)
+                this->options.buffers = this->options.workers * 2 + 2;
+            this->options.buffers = std::max(this->options.buffers, this->options.workers + 1);
+        }
+
+        // Compress source file into destination file, return statistics of the run
+        // Queues are closed at the end of a run, so every compressor runs once
+        Report run(const std::string &source, const std::string &destination) {
+            int descriptor = open(source.c_str(), O_RDONLY);
+            if (descriptor < 0)
+                throw std::invalid_argument("cannot open " + source);
+#ifdef POSIX_FADV_SEQUENTIAL
+            posix_fadvise(descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+            std::ofstream output(destination, std::ios::out | std::ios::trunc | std::ios::binary);
+            if (!output) {
+                close(descriptor);
+                throw std::invalid_argument("cannot open " + destination);
+            }
+
+            this->report = Report();
+            this->report.buffers = this->options.buffers;
+            this->pool.assign(this->options.buffers, Buffer());
+            for (auto &buffer: this->pool)
+                this->idle.push(&buffer);
+
+            auto start = Clock::now();
+            this->running = this->options.workers;
+            std::vector<Stage> stages(this->options.workers);
+            std::vector<std::thread> threads;
+            threads.emplace_back(&Compressor::read, this, descriptor);
+            for (auto &stage: stages)
+                threads.emplace_back(&Compressor::work, this, std::ref(stage));
+            try {
+                this->write(output);
+            } catch (...) {
+                this->fail();
+            }
+            for (auto &thread: threads)
+                thread.join();
+            close(descriptor);
+            if (this->failure)
+                std::rethrow_exception(this->failure);
+
+            this->report.seconds = since(start);
+            this->report.workers.threads = this->options.workers;
+            for (const auto &stage: stages) {
+                this->report.workers.busy += stage.busy;
+                this->report.workers.waiting += stage.waiting;
+            }
+            this->report.filled_mean = this->filled.mean_depth();
+            this->report.filled_max = this->filled.max_depth();
+            this->report.done_mean = this->done.mean_depth();
+            this->report.done_max = this->done.max_depth();
+            this->report.idle_mean = this->idle.mean_depth();
+            this->report.idle_max = this->idle.max_depth();
+            return this->report;
+        }
+    };
+
+    inline Report compress(const std::string &source, const std::string &destination,
+                           const Options &options = Options()) {
+        return Compressor(options).run(source, destination);
+    }
+}
+
+#endif //MPI_PIPELINE_H
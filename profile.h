@@ -0,0 +1,144 @@
+#ifndef MPI_PROFILE_H
+#define MPI_PROFILE_H
+
+#include <chrono>
+#include <sstream>
+
+#include "common.h"
+#include "stats.h"
+
+// Per phase wall time and communication accounting of MPI paths
+// Every process records its own phases, MPI_Report reduces them to manager process
+
+namespace Profile {
+
+    enum Phase {
+        Other = 0,
+        Statistic,
+        Reduce,
+        Tree,
+        Encode,
+        Decode,
+        Gather,
+        Broadcast,
+        PhaseCount
+    };
+
+    inline const char *name(int phase) {
+        static const char *names[PhaseCount] = {
+                "other", "statistic", "reduce", "tree", "encode", "decode", "gather", "broadcast"};
+        return names[phase];
+    }
+
+    struct Record {
+        double seconds[PhaseCount] = {};
+        uint64_t bytes_sent[PhaseCount] = {};
+        uint64_t bytes_received[PhaseCount] = {};
+        uint64_t messages_sent[PhaseCount] = {};
+        uint64_t messages_received[PhaseCount] = {};
+        int current = Other;
+    };
+
+    // One record per thread, so threaded tools could use instrumented code paths,
+    // MPI paths run on main thread which owns the record reported by MPI_Report
+    inline Record &record() {
+        static thread_local Record instance;
+        return instance;
+    }
+
+    inline void reset() {
+        record() = Record();
+    }
+
+    // Accounting called by MPI helpers, charged to current phase
+    inline void sent(size_t bytes) {
+        auto &instance = record();
+        instance.bytes_sent[instance.current] += bytes;
+        instance.messages_sent[instance.current] += 1;
+        HUFFMAN_STAT(Stats::add(Stats::MessagesSent, 1));
+        HUFFMAN_STAT(Stats::add(Stats::BytesSent, bytes));
+    }
+
+    inline void received(size_t bytes) {
+        auto &instance = record();
+        instance.bytes_received[instance.current] += bytes;
+        instance.messages_received[instance.current] += 1;
+        HUFFMAN_STAT(Stats::add(Stats::MessagesReceived, 1));
+        HUFFMAN_STAT(Stats::add(Stats::BytesReceived, bytes));
+    }
+
+    // Time of scope is added to given phase, nested scopes restore previous phase on leave
+    class Scope {
+    private:
+        int phase;
+        int previous;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        explicit Scope(int phase) : phase(phase), previous(record().current),
+                                    start(std::chrono::steady_clock::now()) {
+            record().current = phase;
+        }
+
+        Scope(const Scope &) = delete;
+
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope() {
+            auto &instance = record();
+            instance.seconds[this->phase] +=
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start).count();
+            instance.current = this->previous;
+        }
+    };
+
+    // Reduce records of all processes to manager, which returns JSON report like:
+    //   {"ranks":3,"phases":{"encode":{"min_seconds":..,"max_seconds":..,"mean_seconds":..,
+    //    "bytes_sent":..,"bytes_received":..,"messages_sent":..,"messages_received":..},..}}
+    // Other processes return empty string
+    inline std::string MPI_Report() {
+        int world_size;
+        MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+        int world_rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+        const auto &instance = record();
+        Record minimal, maximal, total;
+        MPI_Reduce(instance.seconds, minimal.seconds, PhaseCount, MPI_DOUBLE, MPI_MIN, 0, MPI_COMM_WORLD);
+        MPI_Reduce(instance.seconds, maximal.seconds, PhaseCount, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(instance.seconds, total.seconds, PhaseCount, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(instance.bytes_sent, total.bytes_sent, PhaseCount,
+                   MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(instance.bytes_received, total.bytes_received, PhaseCount,
+                   MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(instance.messages_sent, total.messages_sent, PhaseCount,
+                   MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+        MPI_Reduce(instance.messages_received, total.messages_received, PhaseCount,
+                   MPI_UINT64_T, MPI_SUM, 0, MPI_COMM_WORLD);
+        if (world_rank != 0)
+            return "";
+
+        std::ostringstream stream;
+        stream << "{\"ranks\":" << world_size << ",\"phases\":{";
+        bool first = true;
+        for (int phase = 0; phase < PhaseCount; ++phase) {
+            if (maximal.seconds[phase] == 0. && total.messages_sent[phase] == 0 &&
+                total.messages_received[phase] == 0)
+                continue;
+            if (!first)
+                stream << ",";
+            first = false;
+            stream << "\"" << name(phase) << "\":{\"min_seconds\":" << minimal.seconds[phase]
+                   << ",\"max_seconds\":" << maximal.seconds[phase]
+                   << ",\"mean_seconds\":" << total.seconds[phase] / world_size
+                   << ",\"bytes_sent\":" << total.bytes_sent[phase]
+                   << ",\"bytes_received\":" << total.bytes_received[phase]
+                   << ",\"messages_sent\":" << total.messages_sent[phase]
+                   << ",\"messages_received\":" << total.messages_received[phase] << "}";
+        }
+        stream << "}}";
+        return stream.str();
+    }
+}
+
+#endif //MPI_PROFILE_H
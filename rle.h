@@ -3,10 +3,18 @@
 
 #include "common.h"
 #include "utils.h"
+#include "transport.h"
+#include "stats.h"
 
 namespace RLE {
     template<typename Iterator, typename Inserter>
     void encode(Iterator begin, Iterator end, Inserter inserter) {
+        // Empty input has no first element to start a run from
+        if (begin == end)
+            return;
+        HUFFMAN_CYCLES(Stats::Encode);
+        HUFFMAN_STAT(uint64_t elements = 0);
+        HUFFMAN_STAT(uint64_t runs = 1);
         uint8_t count = 0;
         auto previous = *begin;
         while (begin != end) {
@@ -17,25 +25,39 @@ namespace RLE {
             } else {
                 inserter = count;
                 inserter = previous;
+                HUFFMAN_STAT(elements += count);
+                HUFFMAN_STAT(runs++);
                 previous = current;
                 count = 0;
             }
         }
         inserter = count;
         inserter = previous;
+        HUFFMAN_STAT(elements += count);
+        HUFFMAN_STAT(Stats::add(Stats::Runs, runs));
+        HUFFMAN_STAT(Stats::add(Stats::BytesIn, elements * sizeof(previous)));
+        HUFFMAN_STAT(Stats::add(Stats::BytesOut, runs * 2 * sizeof(previous)));
     }
 
     template<typename Iterator, typename Inserter>
     void decode(Iterator begin, Iterator end, Inserter inserter) {
         if (std::distance(begin, end) % 2 != 0)
             throw std::length_error("invalid encoded size");
+        HUFFMAN_CYCLES(Stats::Decode);
+        HUFFMAN_STAT(uint64_t runs = 0);
+        HUFFMAN_STAT(uint64_t elements = 0);
         while (begin != end) {
             auto count = (uint8_t) *begin;
             begin++;
             for (uint8_t _ = 0; _ < count; ++_)
                 inserter = *(begin);
             begin++;
+            HUFFMAN_STAT(runs++);
+            HUFFMAN_STAT(elements += count);
         }
+        HUFFMAN_STAT(Stats::add(Stats::Runs, runs));
+        HUFFMAN_STAT(Stats::add(Stats::BytesIn, runs * 2 * sizeof(*begin)));
+        HUFFMAN_STAT(Stats::add(Stats::BytesOut, elements * sizeof(*begin)));
     }
 
     template<typename Iterator, typename Inserter>
@@ -61,19 +83,26 @@ namespace RLE {
         int offset = static_cast<int>(n) / world_size;
         auto start = begin + world_rank * offset * 2;
         auto stop = (world_rank == world_size - 1) ? end : start + offset * 2;
-        decode(start, stop, std::back_inserter(pool));
+        {
+            Profile::Scope scope(Profile::Decode);
+            decode(start, stop, std::back_inserter(pool));
+        }
 
         // Send proceed elements in processes except manager one to manager
-        if (world_rank == 0) {
-            for (int source = 1; source < world_size; ++source) {
-                std::vector<DataType> part = MPI_Receive_vector<DataType>(source, 0);
-                pool.insert(pool.end(), part.begin(), part.end());
+        {
+            Profile::Scope scope(Profile::Gather);
+            if (world_rank == 0) {
+                for (int source = 1; source < world_size; ++source) {
+                    std::vector<DataType> part = MPI_Receive_vector<DataType>(source, 0);
+                    pool.insert(pool.end(), part.begin(), part.end());
+                }
+            } else {
+                MPI_Send_vector<DataType>(pool, 0, 0);
             }
-        } else {
-            MPI_Send_vector<DataType>(pool, 0, 0);
         }
 
         // Synchronizing from manager to workers
+        Profile::Scope scope(Profile::Broadcast);
         if (world_rank == 0) {
             for (int dest = 1; dest < world_size; ++dest) {
                 MPI_Send_vector<DataType>(pool, dest, 2);
@@ -108,19 +137,26 @@ namespace RLE {
         int offset = static_cast<int>(n) / world_size;
         auto start = begin + world_rank * offset;
         auto stop = (world_rank == world_size - 1) ? end : start + offset;
-        encode(start, stop, std::back_inserter(pool));
+        {
+            Profile::Scope scope(Profile::Encode);
+            encode(start, stop, std::back_inserter(pool));
+        }
 
         // Send proceed elements in processes except manager one to manager
-        if (world_rank == 0) {
-            for (int source = 1; source < world_size; ++source) {
-                std::vector<DataType> part = MPI_Receive_vector<DataType>(source, 0);
-                pool.insert(pool.end(), part.begin(), part.end());
+        {
+            Profile::Scope scope(Profile::Gather);
+            if (world_rank == 0) {
+                for (int source = 1; source < world_size; ++source) {
+                    std::vector<DataType> part = MPI_Receive_vector<DataType>(source, 0);
+                    pool.insert(pool.end(), part.begin(), part.end());
+                }
+            } else {
+                MPI_Send_vector<DataType>(pool, 0, 0);
             }
-        } else {
-            MPI_Send_vector<DataType>(pool, 0, 0);
         }
 
         // Synchronizing from manager to workers
+        Profile::Scope scope(Profile::Broadcast);
         if (world_rank == 0) {
             for (int dest = 1; dest < world_size; ++dest) {
                 MPI_Send_vector<DataType>(pool, dest, 2);
@@ -135,6 +171,26 @@ namespace RLE {
         for (const auto &item: pool)
             inserter = item;
     }
+
+    // Pipelined version of MPI_Encode, blocks of every process are sent while
+    // the next one is encoded, see Transport::MPI_Encode_pipelined
+    template<typename Iterator, typename Inserter>
+    void MPI_Encode_pipelined(Iterator begin, Iterator end, Inserter inserter,
+                              size_t block = Transport::BlockSize) {
+        // Ensure iterator generates POD type
+        using DataType = typename std::iterator_traits<Iterator>::value_type;
+        static_assert(std::is_pod<DataType>::value, "T is not a POD type");
+
+        auto pool = Transport::MPI_Encode_pipelined(begin, end, block, [](Iterator first, Iterator last) {
+            std::vector<DataType> part;
+            encode(first, last, std::back_inserter(part));
+            return part;
+        });
+
+        // Write back to result
+        for (const auto &item: pool)
+            inserter = item;
+    }
 }
 
 #endif //MPI_RLE_H
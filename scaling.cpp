@@ -0,0 +1,77 @@
+#include <iostream>
+
+#include "common.h"
+
+#include "huffman.h"
+#include "rle.h"
+#include "bench.h"
+#include "profile.h"
+
+// Run one MPI pipeline and report total time with per phase accounting
+//   Usage: mpirun -n <ranks> scaling [--size 1000000] [--mode strong|weak] [--engine huffman|huffman_pipelined|rle|rle_pipelined]
+//                                    [--profile text] [--repeat 3]
+// In strong mode size is the total input size, in weak mode it is the input size per process.
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+
+    int world_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+    size_t size = 1000000;
+    size_t repeat = 3;
+    std::string mode = "strong";
+    std::string engine = "huffman";
+    std::string profile = "text";
+    for (int index = 1; index + 1 < argc; index += 2) {
+        std::string key = argv[index];
+        std::string value = argv[index + 1];
+        if (key == "--size")
+            size = std::stoul(value);
+        else if (key == "--mode")
+            mode = value;
+        else if (key == "--engine")
+            engine = value;
+        else if (key == "--profile")
+            profile = value;
+        else if (key == "--repeat")
+            repeat = std::stoul(value);
+        else
+            throw std::invalid_argument("unknown option: " + key);
+    }
+    if (mode != "strong" && mode != "weak")
+        throw std::invalid_argument("unknown mode: " + mode);
+
+    size_t n = mode == "weak" ? size * world_size : size;
+    std::string source = Bench::Profile::generate(profile, n);
+
+    // Only the last repetition is profiled, earlier ones warm up caches
+    auto result = Bench::run(engine, profile, n, repeat, [&]() {
+        Profile::reset();
+        if (engine == "rle" || engine == "rle_pipelined") {
+            std::string encoded;
+            if (engine == "rle")
+                RLE::MPI_Encode(source.begin(), source.end(), std::back_inserter(encoded));
+            else
+                RLE::MPI_Encode_pipelined(source.begin(), source.end(), std::back_inserter(encoded));
+            return encoded.size() * 8;
+        }
+        Huffman::Encoder<char> encoder(source.begin(), source.end(), true);
+        if (engine == "huffman_pipelined")
+            return encoder.dict().size() + encoder.MPI_Encode_pipelined(source.begin(), source.end()).size();
+        return encoder.dict().size() + encoder.MPI_Encode(source.begin(), source.end()).size();
+    }, true);
+    auto report = Profile::MPI_Report();
+
+    if (world_rank == 0) {
+        std::cout << "{\"engine\":\"" << engine << "\",\"mode\":\"" << mode << "\",\"profile\":\"" << profile
+                  << "\",\"size\":" << n << ",\"ranks\":" << world_size
+                  << ",\"total_seconds\":" << result.best << ",\"mb_per_second\":" << result.throughput()
+                  << ",\"profile_report\":" << report << "}" << std::endl;
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,28 @@
+#!/bin/sh
+# Strong and weak scaling sweeps of scaling driver on a single machine
+#   Usage: ./scaling.sh [max ranks] [size] [engine] [extra mpirun flags]
+# Efficiency of strong scaling is T(1) / (n * T(n)), of weak scaling is T(1) / T(n).
+# Raw JSON reports of every run are kept in scaling.jsonl.
+
+MAX=${1:-4}
+SIZE=${2:-1000000}
+ENGINE=${3:-huffman}
+FLAGS=${4:-}
+OUTPUT=scaling.jsonl
+
+: > $OUTPUT
+for MODE in strong weak; do
+    BASE=""
+    printf "%-6s %5s %12s %10s\n" mode ranks seconds efficiency
+    RANKS=1
+    while [ $RANKS -le $MAX ]; do
+        LINE=$(mpirun $FLAGS -n $RANKS ./scaling --size $SIZE --mode $MODE --engine $ENGINE)
+        echo "$LINE" >> $OUTPUT
+        SECONDS_=$(echo "$LINE" | sed 's/.*"total_seconds":\([^,]*\).*/\1/')
+        [ -z "$BASE" ] && BASE=$SECONDS_
+        EFFICIENCY=$(awk -v base="$BASE" -v time="$SECONDS_" -v n="$RANKS" -v mode="$MODE" \
+            'BEGIN { if (mode == "strong") printf "%.3f", base / (n * time); else printf "%.3f", base / time }')
+        printf "%-6s %5d %12s %10s\n" $MODE $RANKS $SECONDS_ $EFFICIENCY
+        RANKS=$((RANKS + 1))
+    done
+done
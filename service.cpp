@@ -0,0 +1,58 @@
+#include <iostream>
+
+#include "common.h"
+
+#include "block.h"
+#include "service.h"
+
+// Compression service, manager watches spool directory and workers compress blocks
+//   Usage: mpirun -n <ranks> service [--spool spool] [--output output] [--block 1048576]
+//                                    [--depth 2] [--memory 67108864] [--interval 100] [--once]
+//          service --decompress <compressed file> <output file>
+// Producers should write a file under a hidden name (starting with '.') and rename it
+// into spool when complete. Creating a file named STOP in spool shuts the service down
+// after every pending job is written and removes STOP, --once exits as soon as spool is drained.
+
+int main(int argc, char **argv) {
+    if (argc == 4 && std::string(argv[1]) == "--decompress") {
+        Block::decompress(argv[2], argv[3]);
+        return 0;
+    }
+
+    MPI_Init(&argc, &argv);
+
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+    Service::Options options;
+    for (int index = 1; index < argc; ++index) {
+        std::string key = argv[index];
+        if (key == "--once") {
+            options.once = true;
+            continue;
+        }
+        if (index + 1 >= argc)
+            break;
+        std::string value = argv[++index];
+        if (key == "--spool")
+            options.spool = value;
+        else if (key == "--output")
+            options.output = value;
+        else if (key == "--block")
+            options.block = std::stoul(value);
+        else if (key == "--depth")
+            options.depth = std::stoul(value);
+        else if (key == "--memory")
+            options.memory = std::stoul(value);
+        else if (key == "--interval")
+            options.interval = std::stoi(value);
+    }
+
+    if (world_rank == 0)
+        Service::Manager(options).run();
+    else
+        Service::worker();
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,333 @@
+#ifndef MPI_SERVICE_H
+#define MPI_SERVICE_H
+
+#include <set>
+#include <list>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <filesystem>
+
+#include "common.h"
+#include "block.h"
+#include "profile.h"
+
+// Long running compression service on top of MPI
+// Manager (rank 0) watches a spool directory, splits every new file into blocks
+// and hands blocks to workers, compressed blocks are written back in order.
+// Scheduling is demand driven: every worker holds at most `depth` blocks and gets
+// a new one each time it returns a result, so faster workers take more blocks.
+// Reading stops while too many bytes are read but not yet written (backpressure).
+
+namespace Service {
+
+    // Message tags, payload uses tag + 1
+    static const int JobTag = 32;
+    static const int ResultTag = 34;
+
+    struct Header {
+        uint64_t job = 0;
+        uint64_t index = 0;
+        uint64_t length = 0;
+        uint64_t stop = 0;
+    };
+
+    struct Options {
+        std::string spool = "spool";
+        std::string output = "output";
+        size_t block = 1 << 20;         // input bytes per block
+        size_t depth = 2;               // in flight blocks per worker
+        size_t memory = 64 << 20;       // input bytes read but not written before reading pauses
+        bool once = false;              // exit when spool is drained instead of waiting for STOP file
+        int interval = 100;             // milliseconds between spool scans
+    };
+
+    // Receive blocks from manager and send compressed ones back until stop message arrives
+    inline void worker() {
+        while (true) {
+            Header header;
+            MPI_Recv(&header, sizeof(Header), MPI_BYTE, 0, JobTag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            Profile::received(sizeof(Header));
+            if (header.stop)
+                break;
+            std::vector<char> data(header.length);
+            MPI_Recv(data.data(), static_cast<int>(data.size()), MPI_BYTE, 0, JobTag + 1,
+                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            Profile::received(data.size());
+
+            std::vector<char> compressed;
+            {
+                Profile::Scope scope(Profile::Encode);
+                compressed = Block::compress(data.begin(), data.end());
+            }
+            header.length = compressed.size();
+            MPI_Send(&header, sizeof(Header), MPI_BYTE, 0, ResultTag, MPI_COMM_WORLD);
+            MPI_Send(compressed.data(), static_cast<int>(compressed.size()), MPI_BYTE, 0, ResultTag + 1,
+                     MPI_COMM_WORLD);
+            Profile::sent(sizeof(Header));
+            Profile::sent(compressed.size());
+        }
+    }
+
+    class Manager {
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Job {
+            std::string name;
+            std::filesystem::path path;
+            std::ifstream input;
+            std::ofstream output;
+            uint64_t blocks = 0;            // blocks read
+            uint64_t written = 0;           // blocks written
+            bool exhausted = false;
+            size_t bytes_in = 0;
+            size_t bytes_out = 0;
+            std::map<uint64_t, std::vector<char>> done;
+            std::map<uint64_t, size_t> lengths;
+            Clock::time_point start;
+        };
+
+        struct Task {
+            uint64_t job;
+            uint64_t index;
+            std::vector<char> data;
+        };
+
+        // Non blocking send kept alive until both requests complete
+        struct Outgoing {
+            Header header;
+            std::vector<char> payload;
+            MPI_Request requests[2];
+        };
+
+        Options options;
+        int world_size;
+        uint64_t next_job = 0;
+        std::map<uint64_t, Job> jobs;
+        std::set<std::string> known;
+        std::deque<Task> queue;
+        std::list<Outgoing> outgoing;
+        std::vector<size_t> in_flight;
+        std::vector<size_t> handled;
+        size_t buffered = 0;
+        bool stopping = false;
+        Clock::time_point scanned;
+
+        // Find new files in spool directory
+        void scan() {
+            this->scanned = Clock::now();
+            std::vector<std::filesystem::path> found;
+            for (const auto &entry: std::filesystem::directory_iterator(this->options.spool)) {
+                auto name = entry.path().filename().string();
+                if (name == "STOP") {
+                    this->stopping = true;
+                    continue;
+                }
+                if (!entry.is_regular_file() || name.empty() || name[0] == '.' || this->known.count(name))
+                    continue;
+                found.push_back(entry.path());
+            }
+            std::sort(found.begin(), found.end());
+            for (const auto &path: found) {
+                auto &job = this->jobs[this->next_job++];
+                job.name = path.filename().string();
+                job.path = path;
+                job.input.open(path, std::ios::in | std::ios::binary);
+                job.output.open(this->target(job.name, true), std::ios::out | std::ios::trunc | std::ios::binary);
+                job.start = Clock::now();
+                this->known.insert(job.name);
+            }
+        }
+
+        [[nodiscard]] std::filesystem::path target(const std::string &name, bool temporary) const {
+            return std::filesystem::path(this->options.output) / (name + (temporary ? ".huff.tmp" : ".huff"));
+        }
+
+        // Read blocks while memory budget and queue length allow
+        bool read() {
+            bool progress = false;
+            size_t limit = std::max<size_t>(1, this->world_size - 1) * this->options.depth * 2;
+            for (auto &[id, job]: this->jobs) {
+                while (!job.exhausted && this->buffered < this->options.memory && this->queue.size() < limit) {
+                    Task task{id, job.blocks, std::vector<char>(this->options.block)};
+                    job.input.read(task.data.data(), static_cast<std::streamsize>(task.data.size()));
+                    task.data.resize(job.input.gcount());
+                    if (task.data.empty()) {
+                        job.exhausted = true;
+                        break;
+                    }
+                    job.lengths[job.blocks++] = task.data.size();
+                    job.bytes_in += task.data.size();
+                    this->buffered += task.data.size();
+                    this->queue.push_back(std::move(task));
+                    progress = true;
+                }
+            }
+            return progress;
+        }
+
+        // Hand queued blocks to workers with free slots
+        bool dispatch() {
+            bool progress = false;
+            if (this->world_size == 1) {
+                while (!this->queue.empty()) {
+                    auto &task = this->queue.front();
+                    this->jobs[task.job].done[task.index] = Block::compress(task.data.begin(), task.data.end());
+                    this->queue.pop_front();
+                    progress = true;
+                }
+                return progress;
+            }
+            for (int dest = 1; dest < this->world_size && !this->queue.empty(); ++dest) {
+                while (this->in_flight[dest] < this->options.depth && !this->queue.empty()) {
+                    auto &task = this->queue.front();
+                    auto &send = this->outgoing.emplace_back();
+                    send.header.job = task.job;
+                    send.header.index = task.index;
+                    send.header.length = task.data.size();
+                    send.payload = std::move(task.data);
+                    MPI_Isend(&send.header, sizeof(Header), MPI_BYTE, dest, JobTag, MPI_COMM_WORLD,
+                              &send.requests[0]);
+                    MPI_Isend(send.payload.data(), static_cast<int>(send.payload.size()), MPI_BYTE, dest,
+                              JobTag + 1, MPI_COMM_WORLD, &send.requests[1]);
+                    Profile::sent(sizeof(Header));
+                    Profile::sent(send.payload.size());
+                    this->queue.pop_front();
+                    this->in_flight[dest]++;
+                    progress = true;
+                }
+            }
+            return progress;
+        }
+
+        // Receive compressed blocks returned by workers
+        bool collect() {
+            bool progress = false;
+            while (true) {
+                int flag;
+                MPI_Status status;
+                MPI_Iprobe(MPI_ANY_SOURCE, ResultTag, MPI_COMM_WORLD, &flag, &status);
+                if (!flag)
+                    break;
+                Header header;
+                MPI_Recv(&header, sizeof(Header), MPI_BYTE, status.MPI_SOURCE, ResultTag,
+                         MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                std::vector<char> compressed(header.length);
+                MPI_Recv(compressed.data(), static_cast<int>(compressed.size()), MPI_BYTE, status.MPI_SOURCE,
+                         ResultTag + 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                Profile::received(sizeof(Header));
+                Profile::received(compressed.size());
+                this->jobs[header.job].done[header.index] = std::move(compressed);
+                this->in_flight[status.MPI_SOURCE]--;
+                this->handled[status.MPI_SOURCE]++;
+                progress = true;
+            }
+
+            // Release finished sends
+            for (auto iterator = this->outgoing.begin(); iterator != this->outgoing.end();) {
+                int flag;
+                MPI_Testall(2, iterator->requests, &flag, MPI_STATUSES_IGNORE);
+                iterator = flag ? this->outgoing.erase(iterator) : std::next(iterator);
+            }
+            return progress;
+        }
+
+        // Write finished blocks of every job in order, finish jobs fully written
+        bool flush() {
+            bool progress = false;
+            for (auto iterator = this->jobs.begin(); iterator != this->jobs.end();) {
+                auto &job = iterator->second;
+                for (auto found = job.done.find(job.written); found != job.done.end();
+                     found = job.done.find(job.written)) {
+                    Block::write(job.output, found->second);
+                    job.bytes_out += found->second.size() + sizeof(uint64_t);
+                    this->buffered -= job.lengths[job.written];
+                    job.lengths.erase(job.written);
+                    job.done.erase(found);
+                    job.written++;
+                    progress = true;
+                }
+                if (job.exhausted && job.written == job.blocks) {
+                    this->finish(job);
+                    iterator = this->jobs.erase(iterator);
+                    progress = true;
+                } else {
+                    iterator++;
+                }
+            }
+            return progress;
+        }
+
+        // Publish output and move input out of spool
+        void finish(Job &job) {
+            job.input.close();
+            job.output.close();
+            std::filesystem::rename(this->target(job.name, true), this->target(job.name, false));
+            auto done = std::filesystem::path(this->options.spool) / "done";
+            std::filesystem::create_directories(done);
+            std::filesystem::rename(job.path, done / job.name);
+            this->known.erase(job.name);
+
+            double seconds = std::chrono::duration<double>(Clock::now() - job.start).count();
+            size_t total = 0;
+            for (const auto &count: this->in_flight)
+                total += count;
+            std::cout << "{\"job\":\"" << job.name << "\",\"bytes_in\":" << job.bytes_in
+                      << ",\"bytes_out\":" << job.bytes_out << ",\"blocks\":" << job.blocks
+                      << ",\"seconds\":" << seconds
+                      << ",\"mb_per_second\":" << static_cast<double>(job.bytes_in) / 1e6 / seconds
+                      << ",\"in_flight\":" << total << ",\"queued\":" << this->queue.size()
+                      << ",\"buffered\":" << this->buffered << "}" << std::endl;
+        }
+
+    public:
+        explicit Manager(const Options &options) : options(options) {
+            MPI_Comm_size(MPI_COMM_WORLD, &this->world_size);
+            this->in_flight.resize(this->world_size, 0);
+            this->handled.resize(this->world_size, 0);
+            std::filesystem::create_directories(this->options.spool);
+            std::filesystem::create_directories(this->options.output);
+        }
+
+        void run() {
+            this->scan();
+            while (true) {
+                bool progress = false;
+                if (Clock::now() - this->scanned >= std::chrono::milliseconds(this->options.interval))
+                    this->scan();
+                progress |= this->read();
+                progress |= this->dispatch();
+                progress |= this->collect();
+                progress |= this->flush();
+
+                bool idle = this->jobs.empty() && this->queue.empty();
+                if (idle && (this->stopping || this->options.once))
+                    break;
+                if (!progress)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            // Shutdown is acknowledged, remove STOP so that the next service on this spool keeps running
+            if (this->stopping) {
+                std::error_code error;
+                std::filesystem::remove(std::filesystem::path(this->options.spool) / "STOP", error);
+            }
+
+            // Stop all workers
+            for (int dest = 1; dest < this->world_size; ++dest) {
+                Header header;
+                header.stop = 1;
+                MPI_Send(&header, sizeof(Header), MPI_BYTE, dest, JobTag, MPI_COMM_WORLD);
+                Profile::sent(sizeof(Header));
+            }
+            for (auto &send: this->outgoing)
+                MPI_Waitall(2, send.requests, MPI_STATUSES_IGNORE);
+            for (int rank = 1; rank < this->world_size; ++rank)
+                std::cout << "{\"worker\":" << rank << ",\"blocks\":" << this->handled[rank] << "}" << std::endl;
+        }
+    };
+}
+
+#endif //MPI_SERVICE_H
@@ -0,0 +1,192 @@
+#ifndef MPI_STATS_H
+#define MPI_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "common.h"
+
+// Hot path counters of codecs and MPI helpers, compiled in only with -DHUFFMAN_STATS
+// Hooks are written as HUFFMAN_STAT(statement) and HUFFMAN_CYCLES(phase), both expand
+// to nothing otherwise. Counters are relaxed atomics shared by all threads, read them
+// with snapshot() and dump them with Snapshot::json().
+
+#ifdef HUFFMAN_STATS
+#define HUFFMAN_STAT(statement) statement
+#define HUFFMAN_CYCLES_NAME(line) stats_cycles_##line
+#define HUFFMAN_CYCLES_LINE(phase, line) Stats::Cycles HUFFMAN_CYCLES_NAME(line)(phase)
+#define HUFFMAN_CYCLES(phase) HUFFMAN_CYCLES_LINE(phase, __LINE__)
+#else
+#define HUFFMAN_STAT(statement) ((void) 0)
+#define HUFFMAN_CYCLES(phase) ((void) 0)
+#endif
+
+namespace Stats {
+
+    enum Counter {
+        BytesIn = 0,        // bytes consumed by encoders and decoders
+        BytesOut,           // bytes produced by encoders and decoders
+        SymbolsEncoded,
+        SymbolsDecoded,
+        CodeBits,           // Huffman code bits written
+        PriceMillibits,     // code bits expected from price() of the table, in 1/1000 bits
+        TableBuilds,        // Huffman trees built
+        Allocations,        // tree nodes and output buffer growths
+        Runs,               // RLE runs written or read
+        MessagesSent,
+        MessagesReceived,
+        BytesSent,
+        BytesReceived,
+        CounterCount
+    };
+
+    // Same phases as Profile, kept here so that stats do not depend on MPI profiling
+    enum Phase {
+        Statistic = 0,
+        Tree,
+        Encode,
+        Decode,
+        PhaseCount
+    };
+
+    inline const char *name(int counter) {
+        static const char *names[CounterCount] = {
+                "bytes_in", "bytes_out", "symbols_encoded", "symbols_decoded", "code_bits", "price_millibits",
+                "table_builds", "allocations", "runs", "messages_sent", "messages_received", "bytes_sent",
+                "bytes_received"};
+        return names[counter];
+    }
+
+    inline const char *phase_name(int phase) {
+        static const char *names[PhaseCount] = {"statistic", "tree", "encode", "decode"};
+        return names[phase];
+    }
+
+    constexpr bool enabled() {
+#ifdef HUFFMAN_STATS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    struct Registry {
+        std::atomic<uint64_t> counters[CounterCount] = {};
+        std::atomic<uint64_t> cycles[PhaseCount] = {};
+    };
+
+    inline Registry &registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    inline void add(Counter counter, uint64_t value) {
+        registry().counters[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    // Accounting of one encode or decode call
+    inline void encoded(uint64_t symbols, uint64_t bytes_in, uint64_t bits, uint64_t millibits) {
+        add(SymbolsEncoded, symbols);
+        add(BytesIn, bytes_in);
+        add(BytesOut, (bits + 7) / 8);
+        add(CodeBits, bits);
+        add(PriceMillibits, millibits);
+    }
+
+    inline void decoded(uint64_t symbols, uint64_t bytes_in, uint64_t bytes_out) {
+        add(SymbolsDecoded, symbols);
+        add(BytesIn, bytes_in);
+        add(BytesOut, bytes_out);
+    }
+
+    // Count a buffer growth when capacity differs from last seen one
+    inline void grown(size_t capacity, size_t &last) {
+        if (capacity != last) {
+            last = capacity;
+            add(Allocations, 1);
+        }
+    }
+
+    // Time stamp counter where available, nanoseconds otherwise
+    inline uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    // Cycles of scope are added to given phase
+    class Cycles {
+    private:
+        int phase;
+        uint64_t start;
+
+    public:
+        explicit Cycles(int phase) : phase(phase), start(cycles()) {}
+
+        Cycles(const Cycles &) = delete;
+
+        Cycles &operator=(const Cycles &) = delete;
+
+        ~Cycles() {
+            registry().cycles[this->phase].fetch_add(cycles() - this->start, std::memory_order_relaxed);
+        }
+    };
+
+    struct Snapshot {
+        uint64_t counters[CounterCount] = {};
+        uint64_t cycles[PhaseCount] = {};
+
+        // Average written code length against the one promised by price()
+        [[nodiscard]] double average_code_length() const {
+            auto symbols = this->counters[SymbolsEncoded];
+            return symbols ? static_cast<double>(this->counters[CodeBits]) / static_cast<double>(symbols) : 0.;
+        }
+
+        [[nodiscard]] double average_price() const {
+            auto symbols = this->counters[SymbolsEncoded];
+            return symbols ? static_cast<double>(this->counters[PriceMillibits]) / 1000. /
+                             static_cast<double>(symbols) : 0.;
+        }
+
+        [[nodiscard]] std::string json() const {
+            std::ostringstream stream;
+            stream << "{\"enabled\":" << (enabled() ? "true" : "false");
+            for (int counter = 0; counter < CounterCount; ++counter)
+                stream << ",\"" << name(counter) << "\":" << this->counters[counter];
+            stream << ",\"average_code_length\":" << this->average_code_length()
+                   << ",\"average_price\":" << this->average_price() << ",\"cycles\":{";
+            for (int phase = 0; phase < PhaseCount; ++phase)
+                stream << (phase ? "," : "") << "\"" << phase_name(phase) << "\":" << this->cycles[phase];
+            stream << "}}";
+            return stream.str();
+        }
+    };
+
+    inline Snapshot snapshot() {
+        Snapshot result;
+        auto &instance = registry();
+        for (int counter = 0; counter < CounterCount; ++counter)
+            result.counters[counter] = instance.counters[counter].load(std::memory_order_relaxed);
+        for (int phase = 0; phase < PhaseCount; ++phase)
+            result.cycles[phase] = instance.cycles[phase].load(std::memory_order_relaxed);
+        return result;
+    }
+
+    inline void reset() {
+        auto &instance = registry();
+        for (auto &counter: instance.counters)
+            counter.store(0, std::memory_order_relaxed);
+        for (auto &phase: instance.cycles)
+            phase.store(0, std::memory_order_relaxed);
+    }
+}
+
+#endif //MPI_STATS_H
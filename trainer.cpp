@@ -0,0 +1,149 @@
+#include <chrono>
+#include <iostream>
+#include <filesystem>
+
+#include "common.h"
+
+#include "huffman.h"
+#include "bits.h"
+
+// Train a shared dictionary from files in corpus directory, then compare inline dict
+// encoding with dictionary encoding of held out files the dictionary has not seen
+//   Usage: trainer <corpus directory> [dictionary output] [--eval <directory>]
+// Without --eval every fifth corpus file (in name order) is held out for evaluation.
+
+using Clock = std::chrono::steady_clock;
+
+static std::vector<std::string> load(const std::string &directory) {
+    // Name order keeps the held out split the same on every run
+    std::vector<std::filesystem::path> paths;
+    for (const auto &entry: std::filesystem::directory_iterator(directory))
+        if (entry.is_regular_file())
+            paths.push_back(entry.path());
+    std::sort(paths.begin(), paths.end());
+    std::vector<std::string> samples;
+    for (const auto &path: paths) {
+        std::ifstream reader(path, std::ios::in | std::ios::binary);
+        samples.emplace_back(std::istreambuf_iterator<char>(reader), std::istreambuf_iterator<char>());
+    }
+    return samples;
+}
+
+static double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> arguments;
+    std::string evaluation;
+    for (int index = 1; index < argc; ++index) {
+        std::string key = argv[index];
+        if (key == "--eval" && index + 1 < argc)
+            evaluation = argv[++index];
+        else if (key.rfind("--", 0) == 0)
+            throw std::invalid_argument("unknown option: " + key);
+        else
+            arguments.push_back(key);
+    }
+    if (arguments.empty() || arguments.size() > 2) {
+        std::cerr << "Usage: " << argv[0] << " <corpus directory> [dictionary output] [--eval <directory>]"
+                  << std::endl;
+        return 1;
+    }
+
+    // Dictionary is trained on one set and measured on another, measuring on training
+    // files would credit it with knowing their exact statistics
+    std::vector<std::string> corpus = load(arguments[0]);
+    std::vector<std::string> training_set, samples;
+    if (!evaluation.empty()) {
+        training_set = corpus;
+        samples = load(evaluation);
+    } else {
+        for (size_t index = 0; index < corpus.size(); ++index)
+            (index % 5 == 4 ? samples : training_set).push_back(corpus[index]);
+    }
+    size_t trained = 0;
+    for (const auto &sample: training_set)
+        trained += sample.size();
+    size_t total = 0;
+    for (const auto &sample: samples)
+        total += sample.size();
+    if (trained == 0) {
+        std::cerr << "Training set is empty: " << arguments[0] << std::endl;
+        return 1;
+    }
+    if (total == 0) {
+        std::cerr << "Held out set is empty, use at least 5 corpus files or --eval <directory>" << std::endl;
+        return 1;
+    }
+
+    // Every byte value is in alphabet so that any record could be encoded
+    std::vector<char> alphabet;
+    for (int value = 0; value < 256; ++value)
+        alphabet.push_back(static_cast<char>(value));
+    auto start = Clock::now();
+    auto dictionary = Huffman::Dictionary<char>::train(training_set, alphabet);
+    double training = seconds(start);
+    auto serialized = dictionary.serialize();
+
+    if (arguments.size() > 1) {
+        Bits::BitArray bits(serialized);
+        std::ofstream writer(arguments[1], std::ios::out | std::ios::trunc | std::ios::binary);
+        writer << bits;
+        std::cout << "Saved dictionary to file: " << arguments[1] << std::endl;
+    }
+
+    // Inline dict: every record carries its own frequency mapping
+    size_t inline_bits = 0;
+    bool inline_ok = true;
+    start = Clock::now();
+    for (const auto &sample: samples) {
+        if (sample.empty())
+            continue;
+        Huffman::Encoder<char> encoder(sample.begin(), sample.end());
+        auto encoded = encoder.dict();
+        auto content = encoder.encode();
+        encoded.insert(encoded.end(), content.begin(), content.end());
+        inline_bits += encoded.size();
+        Huffman::Decoder<char> decoder(encoded);
+        std::string decoded;
+        decoder.decode(std::back_inserter(decoded));
+        inline_ok = inline_ok && decoded == sample;
+    }
+    double inline_time = seconds(start);
+
+    // Shared dictionary: records carry only dictionary id
+    size_t shared_bits = 0;
+    bool shared_ok = true;
+    start = Clock::now();
+    Huffman::Encoder<char> encoder(dictionary);
+    Huffman::Decoder<char> decoder(dictionary);
+    auto header = encoder.dict();
+    for (const auto &sample: samples) {
+        if (sample.empty())
+            continue;
+        auto content = encoder.encode(sample.begin(), sample.end());
+        shared_bits += header.size() + content.size();
+        std::string decoded;
+        decoder.decode(content, std::back_inserter(decoded));
+        shared_ok = shared_ok && decoded == sample;
+    }
+    double shared_time = seconds(start);
+
+    auto megabytes = static_cast<double>(total) / 1e6;
+    std::cout << "Training samples: " << training_set.size() << ", total size: " << trained * 8 << std::endl;
+    std::cout << "Held out samples: " << samples.size() << ", total size: " << total * 8 << std::endl;
+    std::cout << "Dictionary id: " << dictionary.id << ", size: " << serialized.size()
+              << ", trained in " << training << "s" << std::endl;
+    std::cout << "Inline dict encoded size: " << inline_bits
+              << ", ratio: " << static_cast<double>(inline_bits) / (total * 8)
+              << ", throughput: " << megabytes / inline_time << " MB/s"
+              << (inline_ok ? "" : " (round trip failed)") << std::endl;
+    std::cout << "Shared dictionary encoded size: " << shared_bits
+              << ", ratio: " << static_cast<double>(shared_bits) / (total * 8)
+              << ", throughput: " << megabytes / shared_time << " MB/s"
+              << (shared_ok ? "" : " (round trip failed)") << std::endl;
+    std::cout << "Ratio gain: " << static_cast<double>(inline_bits) / shared_bits
+              << "x, throughput gain: " << inline_time / shared_time << "x" << std::endl;
+    return inline_ok && shared_ok ? 0 : 1;
+}
@@ -0,0 +1,316 @@
+#ifndef MPI_TRANSPORT_H
+#define MPI_TRANSPORT_H
+
+#include <deque>
+
+#include "common.h"
+#include "profile.h"
+
+// Asynchronous block transport based on MPI_Isend / MPI_Irecv / MPI_Waitany
+// Workers post every block as soon as it is ready and keep computing the next one,
+// manager collects blocks from all sources in arrival order and assembles them by index.
+
+namespace Transport {
+
+    // Default elements per block of pipelined MPI paths
+    static const size_t BlockSize = 1 << 16;
+
+    // Message tags used by pipelined MPI paths, payload uses tag + 1
+    static const int BlockTag = 16;
+
+    // Fixed size header sent before every block payload
+    struct Header {
+        uint64_t index = 0;     // block index inside its source
+        uint64_t length = 0;    // payload bytes
+        uint64_t count = 0;     // element count (bits for packed bits)
+        uint64_t last = 0;      // non zero if no more block from this source
+    };
+
+    // Pack bits into bytes, most significant bit first
+    inline std::vector<char> pack(const std::vector<bool> &bits) {
+        std::vector<char> packed((bits.size() + 7) / 8, 0);
+        for (size_t index = 0; index < bits.size(); ++index)
+            if (bits[index])
+                packed[index / 8] |= static_cast<char>(1 << (7 - index % 8));
+        return packed;
+    }
+
+    inline void unpack(const std::vector<char> &packed, size_t count, std::vector<bool> &bits) {
+        for (size_t index = 0; index < count; ++index)
+            bits.push_back(packed[index / 8] & (1 << (7 - index % 8)));
+    }
+
+    // Pack POD items as raw bytes, both sides of a transfer use the same machine layout
+    template<typename T>
+    std::vector<char> pack(const std::vector<T> &items) {
+        static_assert(std::is_pod<T>::value, "T is not a POD type");
+        std::vector<char> packed(items.size() * sizeof(T));
+        if (!packed.empty())
+            memcpy(packed.data(), items.data(), packed.size());
+        return packed;
+    }
+
+    template<typename T>
+    void unpack(const std::vector<char> &packed, size_t count, std::vector<T> &items) {
+        static_assert(std::is_pod<T>::value, "T is not a POD type");
+        auto first = reinterpret_cast<const T *>(packed.data());
+        items.insert(items.end(), first, first + count);
+    }
+
+    class Sender {
+    private:
+        int destination;
+        int tag;
+        // Posted buffers must stay alive until requests complete, deque keeps references stable
+        std::deque<Header> headers;
+        std::deque<std::vector<char>> payloads;
+        std::vector<MPI_Request> requests;
+
+    public:
+        Sender(int destination, int tag) : destination(destination), tag(tag) {}
+
+        Sender(const Sender &) = delete;
+
+        Sender &operator=(const Sender &) = delete;
+
+        // Start sending one block and return immediately
+        void post(uint64_t index, std::vector<char> &&payload, uint64_t count, bool last) {
+            Header header;
+            header.index = index;
+            header.length = payload.size();
+            header.count = count;
+            header.last = last ? 1 : 0;
+            this->headers.push_back(header);
+            this->payloads.push_back(std::move(payload));
+
+            MPI_Request request;
+            MPI_Isend(&this->headers.back(), sizeof(Header), MPI_BYTE,
+                      this->destination, this->tag, MPI_COMM_WORLD, &request);
+            this->requests.push_back(request);
+            MPI_Isend(this->payloads.back().data(), static_cast<int>(this->payloads.back().size()), MPI_BYTE,
+                      this->destination, this->tag + 1, MPI_COMM_WORLD, &request);
+            this->requests.push_back(request);
+            Profile::sent(sizeof(Header));
+            Profile::sent(header.length);
+        }
+
+        // Block until all posted blocks are sent
+        void wait() {
+            MPI_Waitall(static_cast<int>(this->requests.size()), this->requests.data(), MPI_STATUSES_IGNORE);
+            this->requests.clear();
+            this->headers.clear();
+            this->payloads.clear();
+        }
+
+        ~Sender() {
+            this->wait();
+        }
+    };
+
+    // Receive blocks posted by Sender from given sources in any order
+    class Collector {
+    public:
+        struct Block {
+            uint64_t count = 0;
+            std::vector<char> payload;
+        };
+
+    private:
+        int tag;
+        std::vector<int> sources;
+        std::vector<Header> incoming;           // header receive buffer per source
+        std::vector<Header> pending;            // header of payload being received per source
+        std::vector<std::vector<char>> buffers; // payload receive buffer per source
+        // Requests of source at slot i: [2i] header, [2i + 1] payload
+        std::vector<MPI_Request> requests;
+        std::vector<std::map<uint64_t, Block>> blocks;
+        size_t active;
+
+        void listen(size_t slot) {
+            MPI_Irecv(&this->incoming[slot], sizeof(Header), MPI_BYTE,
+                      this->sources[slot], this->tag, MPI_COMM_WORLD, &this->requests[2 * slot]);
+        }
+
+        void complete(int request) {
+            size_t slot = request / 2;
+            if (request % 2 == 0) {
+                // Header arrived, receive its payload before listening for the next header
+                this->pending[slot] = this->incoming[slot];
+                Profile::received(sizeof(Header));
+                this->buffers[slot].resize(this->pending[slot].length);
+                MPI_Irecv(this->buffers[slot].data(), static_cast<int>(this->pending[slot].length), MPI_BYTE,
+                          this->sources[slot], this->tag + 1, MPI_COMM_WORLD, &this->requests[request + 1]);
+            } else {
+                const auto &header = this->pending[slot];
+                Profile::received(header.length);
+                auto &block = this->blocks[slot][header.index];
+                block.count = header.count;
+                block.payload = std::move(this->buffers[slot]);
+                this->buffers[slot] = std::vector<char>();
+                if (header.last)
+                    this->active--;
+                else
+                    this->listen(slot);
+            }
+        }
+
+    public:
+        Collector(const std::vector<int> &sources, int tag)
+                : tag(tag), sources(sources), incoming(sources.size()), pending(sources.size()),
+                  buffers(sources.size()), requests(sources.size() * 2, MPI_REQUEST_NULL),
+                  blocks(sources.size()), active(sources.size()) {
+            for (size_t slot = 0; slot < sources.size(); ++slot)
+                this->listen(slot);
+        }
+
+        Collector(const Collector &) = delete;
+
+        Collector &operator=(const Collector &) = delete;
+
+        // Handle every arrived message without blocking
+        void poll() {
+            while (this->active) {
+                int index, flag;
+                MPI_Testany(static_cast<int>(this->requests.size()), this->requests.data(),
+                            &index, &flag, MPI_STATUS_IGNORE);
+                if (!flag || index == MPI_UNDEFINED)
+                    return;
+                this->complete(index);
+            }
+        }
+
+        // Block until last block of every source arrived
+        void wait() {
+            while (this->active) {
+                int index;
+                MPI_Waitany(static_cast<int>(this->requests.size()), this->requests.data(),
+                            &index, MPI_STATUS_IGNORE);
+                this->complete(index);
+            }
+        }
+
+        // Blocks of source at given slot ordered by index
+        [[nodiscard]] const std::map<uint64_t, Block> &received(size_t slot) const {
+            return this->blocks[slot];
+        }
+    };
+
+    // Broadcast bytes of manager to all processes
+    inline void MPI_Broadcast_bytes(std::vector<char> &bytes) {
+        int world_rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+        uint64_t size = bytes.size();
+        MPI_Bcast(&size, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+        bytes.resize(size);
+        MPI_Bcast(bytes.data(), static_cast<int>(size), MPI_BYTE, 0, MPI_COMM_WORLD);
+        if (world_rank == 0) {
+            Profile::sent(sizeof(uint64_t));
+            Profile::sent(size);
+        } else {
+            Profile::received(sizeof(uint64_t));
+            Profile::received(size);
+        }
+    }
+
+    // Broadcast bits of manager to all processes in packed form
+    inline void MPI_Broadcast_bits(std::vector<bool> &bits) {
+        int world_rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+        uint64_t count = bits.size();
+        MPI_Bcast(&count, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+        std::vector<char> packed;
+        if (world_rank == 0)
+            packed = pack(bits);
+        MPI_Broadcast_bytes(packed);
+        if (world_rank != 0) {
+            bits.clear();
+            unpack(packed, count, bits);
+        }
+    }
+
+    // Broadcast POD items of manager to all processes
+    template<typename T>
+    void MPI_Broadcast_items(std::vector<T> &items) {
+        auto bytes = pack(items);
+        MPI_Broadcast_bytes(bytes);
+        items.clear();
+        unpack(bytes, bytes.size() / sizeof(T), items);
+    }
+
+    inline void MPI_Broadcast_items(std::vector<bool> &bits) {
+        MPI_Broadcast_bits(bits);
+    }
+
+    // Pipelined encoding shared by MPI paths: every process encodes its part block by block
+    // with encode(first, last) and posts each block asynchronously while encoding the next one,
+    // manager appends its own blocks, then blocks of every other process in rank order,
+    // and broadcasts the result. encode returns std::vector<bool> or a vector of POD items.
+    template<class Iterator, class Encode>
+    auto MPI_Encode_pipelined(Iterator begin, Iterator end, size_t block, Encode encode)
+    -> decltype(encode(begin, end)) {
+        using Result = decltype(encode(begin, end));
+
+        // Get world info
+        int world_size;
+        MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+        int world_rank;
+        MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+        // Decide start end iterator
+        size_t n = std::distance(begin, end);
+        int offset = static_cast<int>(n) / world_size;
+        auto start = begin + world_rank * offset;
+        auto stop = (world_rank == world_size - 1) ? end : start + offset;
+        auto next = [&](Iterator current) {
+            return static_cast<size_t>(std::distance(current, stop)) > block ? current + block : stop;
+        };
+
+        Result encoded;
+        if (world_rank == 0) {
+            std::vector<int> sources;
+            for (int source = 1; source < world_size; ++source)
+                sources.push_back(source);
+            Collector collector(sources, BlockTag);
+
+            // Receive arrived blocks between encoding local blocks
+            for (auto current = start; current != stop; current = next(current)) {
+                Profile::Scope scope(Profile::Encode);
+                auto part = encode(current, next(current));
+                encoded.insert(encoded.end(), part.begin(), part.end());
+                collector.poll();
+            }
+
+            Profile::Scope scope(Profile::Gather);
+            collector.wait();
+            for (size_t slot = 0; slot < sources.size(); ++slot)
+                for (const auto &[index, received]: collector.received(slot))
+                    unpack(received.payload, received.count, encoded);
+        } else {
+            Sender sender(0, BlockTag);
+            uint64_t index = 0;
+            auto current = start;
+            do {
+                // An empty part sends no items, only the last flag
+                Result part;
+                {
+                    Profile::Scope scope(Profile::Encode);
+                    if (current != stop)
+                        part = encode(current, next(current));
+                }
+                current = next(current);
+                Profile::Scope scope(Profile::Gather);
+                sender.post(index++, pack(part), part.size(), current == stop);
+            } while (current != stop);
+
+            Profile::Scope scope(Profile::Gather);
+            sender.wait();
+        }
+
+        // Synchronizing from manager node to worker nodes
+        Profile::Scope scope(Profile::Broadcast);
+        MPI_Broadcast_items(encoded);
+        return encoded;
+    }
+}
+
+#endif //MPI_TRANSPORT_H
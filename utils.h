@@ -2,6 +2,7 @@
 #define MPI_UTILS_H
 
 #include "common.h"
+#include "profile.h"
 
 template<typename T, class Inserter>
 void choices(size_t n, const std::vector<T> &form, Inserter inserter) {
@@ -26,6 +27,9 @@ void MPI_Send_map(const std::map<KT, VT> &map, int destination, int message_no)
     MPI_Send(&size, 1, MPI_UNSIGNED_LONG, destination, message_no, MPI_COMM_WORLD);
     MPI_Send(keys.data(), size * sizeof(KT), MPI_BYTE, destination, message_no + 1, MPI_COMM_WORLD);
     MPI_Send(values.data(), size * sizeof(VT), MPI_BYTE, destination, message_no + 2, MPI_COMM_WORLD);
+    Profile::sent(sizeof(size_t));
+    Profile::sent(size * sizeof(KT));
+    Profile::sent(size * sizeof(VT));
 }
 
 template<typename KT, typename VT>
@@ -41,6 +45,9 @@ std::map<KT, VT> MPI_Receive_map(int source, int message_no) {
     std::vector<VT> values(size);
     MPI_Recv(keys.data(), size * sizeof(KT), MPI_BYTE, source, message_no + 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
     MPI_Recv(values.data(), size * sizeof(VT), MPI_BYTE, source, message_no + 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    Profile::received(sizeof(size_t));
+    Profile::received(size * sizeof(KT));
+    Profile::received(size * sizeof(VT));
 
     // Convert to map
     std::map<KT, VT> map;
@@ -57,6 +64,8 @@ void MPI_Send_vector(const std::vector<T> &items, int destination, int message_n
     size_t size = items.size();
     MPI_Send(&size, 1, MPI_UNSIGNED_LONG, destination, message_no, MPI_COMM_WORLD);
     MPI_Send(items.data(), size * sizeof(T), MPI_BYTE, destination, message_no + 1, MPI_COMM_WORLD);
+    Profile::sent(sizeof(size_t));
+    Profile::sent(size * sizeof(T));
 }
 
 template<typename T>
@@ -68,6 +77,8 @@ std::vector<T> MPI_Receive_vector(int source, int message_no) {
     MPI_Recv(&size, 1, MPI_UNSIGNED_LONG, source, message_no, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
     std::vector<T> receiver(size);
     MPI_Recv(receiver.data(), size * sizeof(T), MPI_BYTE, source, message_no + 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    Profile::received(sizeof(size_t));
+    Profile::received(size * sizeof(T));
     return receiver;
 }
 
@@ -110,12 +121,15 @@ void MPI_Choices(size_t n, const std::vector<T> &form, Inserter inserter) {
 
     // Synchronizing from manager node to worker nodes
     if (world_rank == 0) {
-        for (int dest = 1; dest < world_size; ++dest)
+        for (int dest = 1; dest < world_size; ++dest) {
             MPI_Send(pool.data(), n * sizeof(T), MPI_BYTE, dest, 2, MPI_COMM_WORLD);
+            Profile::sent(n * sizeof(T));
+        }
     } else {
         pool.clear();
         pool.resize(n);
         MPI_Recv(pool.data(), n * sizeof(T), MPI_BYTE, 0, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        Profile::received(n * sizeof(T));
     }
 
     // Write back to result
@@ -0,0 +1,359 @@
+#ifndef MPI_WIDE_H
+#define MPI_WIDE_H
+
+#include <limits>
+
+#include "common.h"
+#include "bits.h"
+#include "huffman.h"
+
+// Huffman coding for wide unsigned integer alphabets, such as uint16_t / uint32_t tokens
+// Used symbols are remapped to dense indexes in sorted order, codes are canonical so that
+// only code lengths are stored, and decoding uses two level lookup tables.
+// The format of encoded dict is:
+//   symbols: gamma(count + 1), natural(first), gamma(second - first), ..., lengths: 5 bits each
+// The format of encoded content is:
+//   elements: gamma(n + 1), codes of n elements
+
+namespace Huffman {
+
+    // Longest code allowed, so that every code fits in two table lookups
+    static const unsigned MaxCodeLength = 24;
+    static const unsigned PrimaryBits = 11;
+
+    // Sorted set of used symbols with symbol to dense index lookup
+    template<typename T>
+    class Symbols {
+        static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value,
+                      "symbol type should be unsigned integer");
+
+    public:
+        std::vector<T> symbols;
+
+    private:
+        // Direct lookup table for small symbol ranges, binary search otherwise
+        static const uint64_t DenseRange = 1 << 20;
+        std::vector<uint32_t> dense;
+
+    public:
+        Symbols() = default;
+
+        explicit Symbols(std::vector<T> &&sorted) : symbols(std::move(sorted)) {
+            if (this->symbols.empty())
+                return;
+            // Span is computed before adding one, a full 64 bits range would wrap to 0
+            uint64_t span = static_cast<uint64_t>(this->symbols.back()) - this->symbols.front();
+            if (span >= DenseRange)
+                return;
+            this->dense.assign(span + 1, UINT32_MAX);
+            for (size_t index = 0; index < this->symbols.size(); ++index)
+                this->dense[this->symbols[index] - this->symbols.front()] = static_cast<uint32_t>(index);
+        }
+
+        // Dense index of symbol, UINT32_MAX if not in set
+        [[nodiscard]] uint32_t index(T symbol) const {
+            if (this->symbols.empty() || symbol < this->symbols.front() || symbol > this->symbols.back())
+                return UINT32_MAX;
+            if (!this->dense.empty())
+                return this->dense[symbol - this->symbols.front()];
+            auto found = std::lower_bound(this->symbols.begin(), this->symbols.end(), symbol);
+            return *found == symbol ? static_cast<uint32_t>(found - this->symbols.begin()) : UINT32_MAX;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return this->symbols.size();
+        }
+    };
+
+    // Code lengths of dense indexes built with Huffman tree, limited to MaxCodeLength
+    inline std::vector<uint8_t> code_lengths(const std::vector<uint64_t> &counts) {
+        std::vector<uint8_t> lengths(counts.size(), 0);
+        if (counts.empty())
+            return lengths;
+
+        std::map<uint32_t, uint64_t> weights;
+        for (size_t index = 0; index < counts.size(); ++index)
+            weights[static_cast<uint32_t>(index)] = counts[index];
+        Tree<uint32_t> tree(weights);
+        for (const auto &[index, code]: tree.traverse())
+            lengths[index] = static_cast<uint8_t>(std::min<size_t>(code.size(), 255));
+
+        // Clamp long codes, then lengthen codes of rare symbols until Kraft inequality holds again
+        if (*std::max_element(lengths.begin(), lengths.end()) <= MaxCodeLength)
+            return lengths;
+        uint64_t capacity = uint64_t(1) << MaxCodeLength;
+        uint64_t kraft = 0;
+        for (auto &length: lengths) {
+            length = std::min<uint8_t>(length, MaxCodeLength);
+            kraft += uint64_t(1) << (MaxCodeLength - length);
+        }
+        std::vector<uint32_t> order(counts.size());
+        for (size_t index = 0; index < order.size(); ++index)
+            order[index] = static_cast<uint32_t>(index);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return counts[a] < counts[b];
+        });
+        while (kraft > capacity) {
+            // Lengthen the longest code still shorter than limit, it costs least
+            uint8_t longest = 0;
+            uint32_t chosen = 0;
+            for (const auto &index: order) {
+                if (lengths[index] < MaxCodeLength && lengths[index] > longest) {
+                    longest = lengths[index];
+                    chosen = index;
+                }
+            }
+            kraft -= uint64_t(1) << (MaxCodeLength - lengths[chosen] - 1);
+            lengths[chosen]++;
+        }
+        return lengths;
+    }
+
+    // Canonical codes of given lengths: shorter codes first, same length ordered by index
+    inline std::vector<uint32_t> canonical_codes(const std::vector<uint8_t> &lengths) {
+        std::vector<uint32_t> order;
+        for (size_t index = 0; index < lengths.size(); ++index)
+            if (lengths[index])
+                order.push_back(static_cast<uint32_t>(index));
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return lengths[a] < lengths[b];
+        });
+        std::vector<uint32_t> codes(lengths.size(), 0);
+        uint32_t code = 0;
+        uint8_t previous = 0;
+        for (const auto &index: order) {
+            code <<= (lengths[index] - previous);
+            previous = lengths[index];
+            codes[index] = code++;
+        }
+        return codes;
+    }
+
+    // Two level decoding table of canonical codes
+    class DecodeTable {
+    private:
+        struct Entry {
+            uint32_t value = 0;     // dense index, or subtable offset when length is 0
+            uint8_t length = 0;     // code length, 0 for subtable pointer
+            uint8_t bits = 0;       // subtable index bits
+        };
+
+        unsigned primary = 0;
+        std::vector<Entry> entries;
+
+    public:
+        DecodeTable() = default;
+
+        explicit DecodeTable(const std::vector<uint8_t> &lengths) {
+            uint64_t kraft = 0;
+            for (const auto &length: lengths)
+                if (length)
+                    kraft += uint64_t(1) << (MaxCodeLength - length);
+            if (kraft > (uint64_t(1) << MaxCodeLength))
+                throw std::invalid_argument("invalid code lengths");
+
+            auto codes = canonical_codes(lengths);
+            unsigned longest = 0;
+            for (const auto &length: lengths)
+                longest = std::max<unsigned>(longest, length);
+            this->primary = std::min(PrimaryBits, longest);
+            this->entries.resize(size_t(1) << this->primary);
+
+            // Longest code under every primary prefix decides its subtable size
+            std::map<uint32_t, unsigned> deepest;
+            for (size_t index = 0; index < lengths.size(); ++index) {
+                if (lengths[index] > this->primary) {
+                    auto prefix = codes[index] >> (lengths[index] - this->primary);
+                    deepest[prefix] = std::max<unsigned>(deepest[prefix], lengths[index] - this->primary);
+                }
+            }
+            for (const auto &[prefix, bits]: deepest) {
+                auto &entry = this->entries[prefix];
+                entry.value = static_cast<uint32_t>(this->entries.size());
+                entry.bits = static_cast<uint8_t>(bits);
+                this->entries.resize(this->entries.size() + (size_t(1) << bits));
+            }
+
+            for (size_t index = 0; index < lengths.size(); ++index) {
+                unsigned length = lengths[index];
+                if (length == 0)
+                    continue;
+                Entry entry;
+                entry.value = static_cast<uint32_t>(index);
+                entry.length = static_cast<uint8_t>(length);
+                size_t first, count;
+                if (length <= this->primary) {
+                    first = size_t(codes[index]) << (this->primary - length);
+                    count = size_t(1) << (this->primary - length);
+                } else {
+                    const auto &pointer = this->entries[codes[index] >> (length - this->primary)];
+                    unsigned rest = length - this->primary;
+                    uint32_t low = codes[index] & ((uint32_t(1) << rest) - 1);
+                    first = pointer.value + (size_t(low) << (pointer.bits - rest));
+                    count = size_t(1) << (pointer.bits - rest);
+                }
+                for (size_t offset = 0; offset < count; ++offset)
+                    this->entries[first + offset] = entry;
+            }
+        }
+
+        // Decode one dense index from reader
+        uint32_t decode(Bits::Reader &reader) const {
+            const Entry *entry = &this->entries[reader.peek(this->primary)];
+            if (entry->length == 0) {
+                if (entry->bits == 0)
+                    throw std::invalid_argument("invalid code");
+                uint32_t low = reader.peek(this->primary + entry->bits) & ((uint32_t(1) << entry->bits) - 1);
+                entry = &this->entries[entry->value + low];
+                if (entry->length == 0)
+                    throw std::invalid_argument("invalid code");
+            }
+            reader.skip(entry->length);
+            return entry->value;
+        }
+    };
+
+    template<typename T>
+    class WideEncoder {
+    private:
+        Symbols<T> alphabet;
+        std::vector<uint64_t> counts;
+        std::vector<uint8_t> lengths;
+        std::vector<uint32_t> codes;
+        std::vector<T> data;
+
+    public:
+        template<class Iterator>
+        WideEncoder(Iterator begin, Iterator end) {
+            static_assert(
+                    std::is_same<typename std::iterator_traits<Iterator>::value_type, T>::value,
+                    "iterator value type should as same as data type");
+
+            this->data.assign(begin, end);
+            std::vector<T> sorted(this->data);
+            std::sort(sorted.begin(), sorted.end());
+            sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+            this->alphabet = Symbols<T>(std::move(sorted));
+
+            this->counts.assign(this->alphabet.size(), 0);
+            for (const auto &item: this->data)
+                this->counts[this->alphabet.index(item)]++;
+            this->lengths = code_lengths(this->counts);
+            this->codes = canonical_codes(this->lengths);
+        }
+
+        // Encode sorted symbol set as gaps and code lengths of every symbol
+        [[nodiscard]] std::vector<bool> dict() const {
+            std::vector<bool> encoded;
+            Bits::append_gamma(encoded, this->alphabet.size() + 1);
+            uint64_t previous = 0;
+            for (size_t index = 0; index < this->alphabet.size(); ++index) {
+                uint64_t symbol = this->alphabet.symbols[index];
+                if (index == 0)
+                    Bits::append_natural(encoded, symbol);
+                else
+                    Bits::append_gamma(encoded, symbol - previous);
+                previous = symbol;
+            }
+            for (const auto &length: this->lengths)
+                Bits::append(encoded, length, 5);
+            return encoded;
+        }
+
+        template<class Iterator>
+        std::vector<bool> encode(Iterator begin, Iterator end) const {
+            std::vector<bool> encoded;
+            Bits::append_gamma(encoded, static_cast<uint64_t>(std::distance(begin, end)) + 1);
+            while (begin != end) {
+                auto index = this->alphabet.index(*begin);
+                if (index == UINT32_MAX)
+                    throw std::invalid_argument("element not in dictionary");
+                Bits::append(encoded, this->codes[index], this->lengths[index]);
+                begin++;
+            }
+            return encoded;
+        }
+
+        [[nodiscard]] std::vector<bool> encode() const {
+            return this->encode(this->data.begin(), this->data.end());
+        }
+
+        // Calculating encoding price:
+        //   sum([encoding_length] * [frequency])
+        [[nodiscard]] float price() const {
+            float result = 0.;
+            for (size_t index = 0; index < this->counts.size(); ++index)
+                result += static_cast<float>(this->counts[index]) * this->lengths[index];
+            return this->data.empty() ? 0.f : result / static_cast<float>(this->data.size());
+        }
+    };
+
+    template<typename T>
+    class WideDecoder {
+        static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value,
+                      "symbol type should be unsigned integer");
+
+    private:
+        std::vector<T> symbols;
+        DecodeTable table;
+        Bits::Reader reader;
+
+        void load(Bits::Reader &source) {
+            auto count = source.gamma() - 1;
+            uint64_t previous = 0;
+            for (size_t index = 0; index < count; ++index) {
+                if (index == 0) {
+                    previous = source.natural();
+                } else {
+                    uint64_t gap = source.gamma();
+                    if (gap > std::numeric_limits<uint64_t>::max() - previous)
+                        throw std::invalid_argument("invalid symbol");
+                    previous += gap;
+                }
+                if (previous > std::numeric_limits<T>::max())
+                    throw std::invalid_argument("invalid symbol");
+                this->symbols.push_back(static_cast<T>(previous));
+            }
+            std::vector<uint8_t> lengths;
+            for (size_t index = 0; index < count; ++index) {
+                lengths.push_back(static_cast<uint8_t>(source.read(5)));
+                if (lengths.back() > MaxCodeLength)
+                    throw std::invalid_argument("invalid code length");
+            }
+            this->table = DecodeTable(lengths);
+        }
+
+    public:
+        // Read dict from bits at given position, content follows it
+        explicit WideDecoder(const std::vector<bool> &bits, size_t position = 0) : reader(bits, position) {
+            this->load(this->reader);
+        }
+
+        // Read dict from a reader shared with other streams, content is decoded with decode(source, inserter)
+        explicit WideDecoder(Bits::Reader &source) : reader(std::vector<bool>()) {
+            this->load(source);
+        }
+
+        // Decode one content stream, further streams could follow using the same dict
+        template<class Inserter>
+        void decode(Inserter inserter) {
+            this->decode(this->reader, inserter);
+        }
+
+        template<class Inserter>
+        void decode(Bits::Reader &source, Inserter inserter) {
+            auto count = source.gamma() - 1;
+            if (count && this->symbols.empty())
+                throw std::invalid_argument("empty dictionary");
+            for (uint64_t index = 0; index < count; ++index)
+                inserter = this->symbols[this->table.decode(source)];
+        }
+
+        // Position after last decoded bit
+        [[nodiscard]] size_t position() const {
+            return this->reader.position();
+        }
+    };
+}
+
+#endif //MPI_WIDE_H